@@ -0,0 +1,197 @@
+#include "BatchConverter.h"
+#include "DataFile.h"
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+
+cBatchConverter::cBatchConverter()
+    : maConvertQueue( kiQueueDepth )
+    , maWriteQueue( kiQueueDepth )
+    , miNumFailed( 0 )
+    , miNumConvertThreadsRunning( 0 )
+{
+}
+
+int cBatchConverter::Run( const std::vector< std::string >& laFilenames )
+{
+    unsigned int liNumConvertThreads = std::thread::hardware_concurrency();
+    if( liNumConvertThreads == 0 )
+    {
+        liNumConvertThreads = 4;
+    }
+    miNumConvertThreadsRunning = liNumConvertThreads;
+
+    // Outputs are named before anything is read, so which extension each gets isn't known yet. Files are told apart
+    // by the name their outputs share without it.
+    std::unordered_map< std::string, std::vector< size_t > > laFilesByOutput;
+    for( size_t ii = 0; ii < laFilenames.size(); ++ii )
+    {
+        laFilesByOutput[ cDtaFile::GetOutputFilename( laFilenames[ ii ], "" ) ].push_back( ii );
+    }
+
+    std::vector< std::string > laUniqueFilenames;
+    std::unordered_set< std::string > laSeenFilenames;
+    for( const std::string& lFilename : laFilenames )
+    {
+        if( !laSeenFilenames.insert( lFilename ).second )
+        {
+            Report( lFilename + ": Listed more than once", true );
+            continue;
+        }
+
+        laUniqueFilenames.push_back( lFilename );
+        if( laFilesByOutput[ cDtaFile::GetOutputFilename( lFilename, "" ) ].size() > 1 )
+        {
+            maSharedOutputFilenames.insert( lFilename );
+        }
+    }
+
+    std::vector< std::thread > laThreads;
+    laThreads.emplace_back( [ this, &laUniqueFilenames ] { ReadStage( laUniqueFilenames ); } );
+    for( unsigned int ii = 0; ii < liNumConvertThreads; ++ii )
+    {
+        laThreads.emplace_back( [ this ] { ConvertStage(); } );
+    }
+    laThreads.emplace_back( [ this ] { WriteStage(); } );
+
+    for( std::thread& lThread : laThreads )
+    {
+        lThread.join();
+    }
+
+    return miNumFailed;
+}
+
+void cBatchConverter::ReadStage( const std::vector< std::string >& laFilenames )
+{
+    std::unique_ptr< cFileIo > lpFileIo = cFileIo::Create( kiQueueDepth );
+
+    size_t liNextFile = 0;
+    int liNumInFlight = 0;
+    while( liNextFile < laFilenames.size() || liNumInFlight > 0 )
+    {
+        while( liNumInFlight < kiQueueDepth && liNextFile < laFilenames.size() )
+        {
+            sFileRequest* lpRequest = new sFileRequest;
+            lpRequest->mFilename = laFilenames[ liNextFile++ ];
+            lpFileIo->Submit( lpRequest );
+            ++liNumInFlight;
+        }
+
+        sFileRequest* lpRequest = lpFileIo->WaitForCompletion();
+        if( !lpRequest )
+        {
+            Report( "Error waiting for reads to complete", true );
+            break;
+        }
+        --liNumInFlight;
+
+        if( !lpRequest->mbSucceeded )
+        {
+            Report( lpRequest->mError, true );
+            delete lpRequest;
+            continue;
+        }
+
+        maConvertQueue.Push( lpRequest );
+    }
+
+    maConvertQueue.Close();
+}
+
+void cBatchConverter::ConvertStage()
+{
+    sFileRequest* lpRequest = nullptr;
+    while( maConvertQueue.Pop( lpRequest ) )
+    {
+        cDtaFile lDataFile( lpRequest->mData.data(), (int)lpRequest->mData.size() );
+
+        bool lbConverted = false;
+        std::string lOutputFilename;
+        if( !lDataFile.GetError() )
+        {
+            if( lDataFile.LoadedAsBinary() )
+            {
+                lOutputFilename = GetOutputFilename( lpRequest->mFilename, ".txt" );
+                lbConverted = lDataFile.ConvertToText( lpRequest->mData );
+            }
+            else
+            {
+                lOutputFilename = GetOutputFilename( lpRequest->mFilename, ".bin" );
+                lbConverted = lDataFile.ConvertToBinary( lpRequest->mData );
+            }
+        }
+
+        if( !lbConverted )
+        {
+            Report( lpRequest->mFilename + ": " + lDataFile.GetError(), true );
+            delete lpRequest;
+            continue;
+        }
+
+        lpRequest->mFilename = lOutputFilename;
+        lpRequest->mbWrite = true;
+        maWriteQueue.Push( lpRequest );
+    }
+
+    if( --miNumConvertThreadsRunning == 0 )
+    {
+        maWriteQueue.Close();
+    }
+}
+
+void cBatchConverter::WriteStage()
+{
+    std::unique_ptr< cFileIo > lpFileIo = cFileIo::Create( kiQueueDepth );
+
+    int liNumInFlight = 0;
+    for( ;; )
+    {
+        // Only block on the queue when there's nothing to wait for, otherwise collect finished writes
+        sFileRequest* lpRequest = nullptr;
+        bool lbHaveRequest = liNumInFlight < kiQueueDepth &&
+            ( liNumInFlight == 0 ? maWriteQueue.Pop( lpRequest ) : maWriteQueue.TryPop( lpRequest ) );
+
+        if( lbHaveRequest )
+        {
+            lpFileIo->Submit( lpRequest );
+            ++liNumInFlight;
+            continue;
+        }
+
+        if( liNumInFlight == 0 )
+        {
+            break;
+        }
+
+        lpRequest = lpFileIo->WaitForCompletion();
+        if( !lpRequest )
+        {
+            Report( "Error waiting for writes to complete", true );
+            break;
+        }
+        --liNumInFlight;
+
+        Report( lpRequest->mbSucceeded ? "Converted to " + lpRequest->mFilename : lpRequest->mError, !lpRequest->mbSucceeded );
+        delete lpRequest;
+    }
+}
+
+std::string cBatchConverter::GetOutputFilename( const std::string& lFilename, const char* lpExtension ) const
+{
+    if( maSharedOutputFilenames.count( lFilename ) )
+    {
+        return lFilename + lpExtension;
+    }
+    return cDtaFile::GetOutputFilename( lFilename, lpExtension );
+}
+
+void cBatchConverter::Report( const std::string& lMessage, bool lbFailed )
+{
+    std::lock_guard< std::mutex > lLock( mReportMutex );
+    std::cout << lMessage << "\n";
+    if( lbFailed )
+    {
+        ++miNumFailed;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "BoundedQueue.h"
+#include "FileIo.h"
+
+// Converts many files at once as a three stage pipeline: asynchronous reads, parsing and conversion on a pool of
+// worker threads, then asynchronous writes. Bounded queues between the stages let disk I/O overlap conversion
+// without loading every file into memory at once.
+class cBatchConverter
+{
+public:
+    static constexpr int kiQueueDepth = 32;
+
+    cBatchConverter();
+
+    // Returns the number of files that failed to convert. Files whose outputs would share a name, such as the PS3
+    // and PS4 builds of one file, keep their whole filename and add the output extension to it instead. Files listed
+    // more than once fail.
+    int Run( const std::vector< std::string >& laFilenames );
+
+private:
+    std::string GetOutputFilename( const std::string& lFilename, const char* lpExtension ) const;
+
+    void ReadStage( const std::vector< std::string >& laFilenames );
+    void ConvertStage();
+    void WriteStage();
+
+    void Report( const std::string& lMessage, bool lbFailed );
+
+    cBoundedQueue< sFileRequest* > maConvertQueue;
+    cBoundedQueue< sFileRequest* > maWriteQueue;
+
+    // Read only while the pipeline runs
+    std::unordered_set< std::string > maSharedOutputFilenames;
+
+    std::mutex                     mReportMutex;
+    int                            miNumFailed;
+    std::atomic< int >             miNumConvertThreadsRunning;
+};
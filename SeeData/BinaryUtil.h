@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Helpers shared by the files this tool writes and maps, which are laid out in the machine's own byte order
+
+// 64 bit FNV-1a
+inline uint64_t HashFnv1a( const char* lpData, size_t liDataSize )
+{
+    uint64_t liHash = 0xcbf29ce484222325ull;
+    for( size_t ii = 0; ii < liDataSize; ++ii )
+    {
+        liHash = ( liHash ^ (uint8_t)lpData[ ii ] ) * 0x100000001b3ull;
+    }
+    return liHash;
+}
+
+template < typename T >
+void Append( std::vector< char >& lOutput, const T& lValue )
+{
+    size_t liOffset = lOutput.size();
+    lOutput.resize( liOffset + sizeof( T ) );
+    memcpy( lOutput.data() + liOffset, &lValue, sizeof( T ) );
+}
@@ -0,0 +1,388 @@
+#include "BlockCompression.h"
+#include <cstring>
+
+namespace
+{
+    constexpr char     kaMagic[ 4 ] = { 'S', 'D', 'Z', '1' };
+    constexpr uint32_t kiStoredBlockFlag = 0x80000000u;
+
+    constexpr int      kiMinMatch = 4;
+    constexpr size_t   kiLastLiterals = 5;     // The final bytes of a block are always literals
+    constexpr size_t   kiMatchSearchLimit = 12; // No match may start this close to the end of a block
+    constexpr int      kiHashBits = 12;
+    constexpr size_t   kiMaxOffset = 65535;
+
+    uint32_t Read32( const uint8_t* lpData )
+    {
+        uint32_t liValue;
+        memcpy( &liValue, lpData, sizeof( liValue ) );
+        return liValue;
+    }
+
+    void Write32( char* lpData, uint32_t liValue )
+    {
+        memcpy( lpData, &liValue, sizeof( liValue ) );
+    }
+
+    uint32_t Hash( uint32_t liSequence )
+    {
+        return ( liSequence * 2654435761u ) >> ( 32 - kiHashBits );
+    }
+
+    // The header is untrusted, so the size it claims is checked against the block table before anyone allocates for
+    // it. The table must hold exactly one entry per block with its bytes in bounds, and no block can claim more than
+    // its bytes could expand to: stored blocks hold exactly their size, and each byte of a compressed block decodes to
+    // at most 255.
+    bool ReadHeader( const char* lpData, size_t liDataSize, size_t& liDecompressedSize, size_t& liBlockSize )
+    {
+        if( !cBlockCompressor::IsCompressed( lpData, liDataSize ) )
+        {
+            return false;
+        }
+
+        liDecompressedSize = Read32( (const uint8_t*)lpData + 4 );
+        liBlockSize = Read32( (const uint8_t*)lpData + 8 );
+        if( liBlockSize == 0 || liBlockSize > cBlockCompressor::kiBlockSize )
+        {
+            return false;
+        }
+
+        const char* lpDataPtr = lpData + cBlockCompressor::kiHeaderSize;
+        const char* lpDataEnd = lpData + liDataSize;
+        for( size_t liOffset = 0; liOffset < liDecompressedSize; liOffset += liBlockSize )
+        {
+            if( lpDataEnd - lpDataPtr < (ptrdiff_t)sizeof( uint32_t ) )
+            {
+                return false;
+            }
+
+            uint32_t liStoredSize = Read32( (const uint8_t*)lpDataPtr );
+            lpDataPtr += sizeof( uint32_t );
+
+            size_t liSourceSize = liStoredSize & ~kiStoredBlockFlag;
+            size_t liThisBlockSize = liDecompressedSize - liOffset < liBlockSize ? liDecompressedSize - liOffset : liBlockSize;
+            bool lbFits = ( liStoredSize & kiStoredBlockFlag ) ? liSourceSize == liThisBlockSize : liThisBlockSize <= liSourceSize * 255;
+            if( !lbFits || liSourceSize > (size_t)( lpDataEnd - lpDataPtr ) )
+            {
+                return false;
+            }
+            lpDataPtr += liSourceSize;
+        }
+
+        return lpDataPtr == lpDataEnd;
+    }
+
+    uint8_t* WriteLength( uint8_t* lpOutput, size_t liLength )
+    {
+        while( liLength >= 255 )
+        {
+            *lpOutput++ = 255;
+            liLength -= 255;
+        }
+        *lpOutput++ = (uint8_t)liLength;
+        return lpOutput;
+    }
+
+    uint8_t* WriteSequence( uint8_t* lpOutput, const uint8_t* lpLiterals, size_t liNumLiterals, size_t liOffset, size_t liMatchLength )
+    {
+        uint8_t* lpToken = lpOutput++;
+        *lpToken = (uint8_t)( ( liNumLiterals < 15 ? liNumLiterals : 15 ) << 4 );
+        if( liNumLiterals >= 15 )
+        {
+            lpOutput = WriteLength( lpOutput, liNumLiterals - 15 );
+        }
+
+        memcpy( lpOutput, lpLiterals, liNumLiterals );
+        lpOutput += liNumLiterals;
+
+        // The last sequence of a block is only literals
+        if( liMatchLength == 0 )
+        {
+            return lpOutput;
+        }
+
+        *lpOutput++ = (uint8_t)( liOffset & 0xFF );
+        *lpOutput++ = (uint8_t)( liOffset >> 8 );
+
+        size_t liExtraLength = liMatchLength - kiMinMatch;
+        *lpToken |= (uint8_t)( liExtraLength < 15 ? liExtraLength : 15 );
+        if( liExtraLength >= 15 )
+        {
+            lpOutput = WriteLength( lpOutput, liExtraLength - 15 );
+        }
+
+        return lpOutput;
+    }
+
+    bool ReadLength( const uint8_t*& lpSource, const uint8_t* lpSourceEnd, size_t& liLength )
+    {
+        uint8_t liByte;
+        do
+        {
+            if( lpSource >= lpSourceEnd )
+            {
+                return false;
+            }
+            liByte = *lpSource++;
+            liLength += liByte;
+        } while( liByte == 255 );
+
+        return true;
+    }
+}
+
+bool cBlockCompressor::IsCompressed( const char* lpData, size_t liDataSize )
+{
+    return liDataSize >= kiHeaderSize && memcmp( lpData, kaMagic, sizeof( kaMagic ) ) == 0;
+}
+
+size_t cBlockCompressor::GetDecompressedSize( const char* lpData, size_t liDataSize )
+{
+    size_t liDecompressedSize = 0;
+    size_t liBlockSize = 0;
+    if( !ReadHeader( lpData, liDataSize, liDecompressedSize, liBlockSize ) )
+    {
+        return 0;
+    }
+    return liDecompressedSize;
+}
+
+void cBlockCompressor::Compress( const char* lpData, size_t liDataSize, std::vector< char >& lOutput )
+{
+    size_t liNumBlocks = ( liDataSize + kiBlockSize - 1 ) / kiBlockSize;
+    lOutput.resize( kiHeaderSize + liNumBlocks * ( sizeof( uint32_t ) + GetCompressedBlockBound( kiBlockSize ) ) );
+
+    memcpy( lOutput.data(), kaMagic, sizeof( kaMagic ) );
+    Write32( lOutput.data() + 4, (uint32_t)liDataSize );
+    Write32( lOutput.data() + 8, (uint32_t)kiBlockSize );
+
+    char* lpOutputPtr = lOutput.data() + kiHeaderSize;
+    for( size_t liOffset = 0; liOffset < liDataSize; liOffset += kiBlockSize )
+    {
+        size_t liSourceSize = liDataSize - liOffset < kiBlockSize ? liDataSize - liOffset : kiBlockSize;
+        const uint8_t* lpSource = (const uint8_t*)lpData + liOffset;
+
+        size_t liCompressedSize = CompressBlock( lpSource, liSourceSize, (uint8_t*)lpOutputPtr + sizeof( uint32_t ) );
+        if( liCompressedSize >= liSourceSize )
+        {
+            Write32( lpOutputPtr, (uint32_t)liSourceSize | kiStoredBlockFlag );
+            memcpy( lpOutputPtr + sizeof( uint32_t ), lpSource, liSourceSize );
+            liCompressedSize = liSourceSize;
+        }
+        else
+        {
+            Write32( lpOutputPtr, (uint32_t)liCompressedSize );
+        }
+
+        lpOutputPtr += sizeof( uint32_t ) + liCompressedSize;
+    }
+
+    lOutput.resize( lpOutputPtr - lOutput.data() );
+}
+
+bool cBlockCompressor::Decompress( const char* lpData, size_t liDataSize, char* lpOutput, size_t liOutputSize )
+{
+    cBlockDecoder lDecoder( lpData, liDataSize );
+    if( !lDecoder.IsValid() || lDecoder.GetDecompressedSize() != liOutputSize )
+    {
+        return false;
+    }
+
+    // Blocks are a fixed size, so each one can be decoded straight into place
+    while( !lDecoder.IsFinished() )
+    {
+        size_t liBlockSize = 0;
+        if( !lDecoder.NextBlock( lpOutput, liBlockSize ) )
+        {
+            return false;
+        }
+        lpOutput += liBlockSize;
+    }
+
+    return true;
+}
+
+size_t cBlockCompressor::CompressBlock( const uint8_t* lpSource, size_t liSourceSize, uint8_t* lpOutput )
+{
+    uint8_t* lpOutputStart = lpOutput;
+    size_t   liAnchor = 0;
+
+    if( liSourceSize > kiMatchSearchLimit )
+    {
+        uint32_t laHashTable[ 1 << kiHashBits ] = {};
+
+        size_t liSearchLimit = liSourceSize - kiMatchSearchLimit;
+        size_t liMatchLimit = liSourceSize - kiLastLiterals;
+        size_t liPosition = 1;
+        unsigned int liMisses = 0;
+
+        while( liPosition < liSearchLimit )
+        {
+            uint32_t liSequence = Read32( lpSource + liPosition );
+            uint32_t& liCandidate = laHashTable[ Hash( liSequence ) ];
+            size_t liMatchPosition = liCandidate;
+            liCandidate = (uint32_t)liPosition;
+
+            if( liPosition - liMatchPosition > kiMaxOffset || Read32( lpSource + liMatchPosition ) != liSequence )
+            {
+                // Step further through data that isn't compressing
+                liPosition += 1 + ( liMisses++ >> 6 );
+                continue;
+            }
+            liMisses = 0;
+
+            while( liPosition > liAnchor && liMatchPosition > 0 && lpSource[ liPosition - 1 ] == lpSource[ liMatchPosition - 1 ] )
+            {
+                --liPosition;
+                --liMatchPosition;
+            }
+
+            size_t liMatchLength = kiMinMatch;
+            while( liPosition + liMatchLength < liMatchLimit && lpSource[ liMatchPosition + liMatchLength ] == lpSource[ liPosition + liMatchLength ] )
+            {
+                ++liMatchLength;
+            }
+
+            lpOutput = WriteSequence( lpOutput, lpSource + liAnchor, liPosition - liAnchor, liPosition - liMatchPosition, liMatchLength );
+            liPosition += liMatchLength;
+            liAnchor = liPosition;
+
+            if( liPosition < liSearchLimit )
+            {
+                laHashTable[ Hash( Read32( lpSource + liPosition - 2 ) ) ] = (uint32_t)( liPosition - 2 );
+            }
+        }
+    }
+
+    lpOutput = WriteSequence( lpOutput, lpSource + liAnchor, liSourceSize - liAnchor, 0, 0 );
+    return lpOutput - lpOutputStart;
+}
+
+bool cBlockCompressor::DecompressBlock( const uint8_t* lpSource, size_t liSourceSize, uint8_t* lpOutput, size_t liOutputSize )
+{
+    const uint8_t* lpSourceEnd = lpSource + liSourceSize;
+    uint8_t*       lpOutputStart = lpOutput;
+    uint8_t*       lpOutputEnd = lpOutput + liOutputSize;
+
+    while( lpSource < lpSourceEnd )
+    {
+        uint8_t liToken = *lpSource++;
+
+        size_t liNumLiterals = liToken >> 4;
+        if( liNumLiterals == 15 && !ReadLength( lpSource, lpSourceEnd, liNumLiterals ) )
+        {
+            return false;
+        }
+
+        if( liNumLiterals > (size_t)( lpSourceEnd - lpSource ) || liNumLiterals > (size_t)( lpOutputEnd - lpOutput ) )
+        {
+            return false;
+        }
+        memcpy( lpOutput, lpSource, liNumLiterals );
+        lpOutput += liNumLiterals;
+        lpSource += liNumLiterals;
+
+        if( lpSource == lpSourceEnd )
+        {
+            break;
+        }
+
+        if( lpSourceEnd - lpSource < 2 )
+        {
+            return false;
+        }
+        size_t liOffset = lpSource[ 0 ] | ( lpSource[ 1 ] << 8 );
+        lpSource += 2;
+
+        size_t liMatchLength = liToken & 0xF;
+        if( liMatchLength == 15 && !ReadLength( lpSource, lpSourceEnd, liMatchLength ) )
+        {
+            return false;
+        }
+        liMatchLength += kiMinMatch;
+
+        if( liOffset == 0 || liOffset > (size_t)( lpOutput - lpOutputStart ) || liMatchLength > (size_t)( lpOutputEnd - lpOutput ) )
+        {
+            return false;
+        }
+
+        const uint8_t* lpMatch = lpOutput - liOffset;
+        if( liOffset >= 16 && lpOutputEnd - lpOutput >= (ptrdiff_t)( liMatchLength + 16 ) )
+        {
+            // Copy in 16 byte chunks, overrunning into the space that's known to be free
+            uint8_t* lpMatchEnd = lpOutput + liMatchLength;
+            do
+            {
+                memcpy( lpOutput, lpMatch, 16 );
+                lpOutput += 16;
+                lpMatch += 16;
+            } while( lpOutput < lpMatchEnd );
+            lpOutput = lpMatchEnd;
+        }
+        else
+        {
+            // Overlapping matches repeat the bytes just written, so they have to go one at a time
+            for( size_t ii = 0; ii < liMatchLength; ++ii )
+            {
+                *lpOutput++ = *lpMatch++;
+            }
+        }
+    }
+
+    return lpOutput == lpOutputEnd;
+}
+
+cBlockDecoder::cBlockDecoder( const char* lpData, size_t liDataSize )
+    : mpDataPtr( lpData )
+    , mpDataEnd( lpData + liDataSize )
+    , miDecompressedSize( 0 )
+    , miDecodedSize( 0 )
+    , miBlockSize( 0 )
+    , mbValid( false )
+{
+    if( !ReadHeader( lpData, liDataSize, miDecompressedSize, miBlockSize ) )
+    {
+        miDecompressedSize = 0;
+        return;
+    }
+
+    mpDataPtr += cBlockCompressor::kiHeaderSize;
+    mbValid = true;
+}
+
+bool cBlockDecoder::NextBlock( char* lpOutput, size_t& liBlockSize )
+{
+    if( !mbValid || IsFinished() || mpDataEnd - mpDataPtr < (ptrdiff_t)sizeof( uint32_t ) )
+    {
+        return false;
+    }
+
+    uint32_t liStoredSize = Read32( (const uint8_t*)mpDataPtr );
+    mpDataPtr += sizeof( uint32_t );
+
+    size_t liSourceSize = liStoredSize & ~kiStoredBlockFlag;
+    if( liSourceSize > (size_t)( mpDataEnd - mpDataPtr ) )
+    {
+        return false;
+    }
+
+    size_t liRemaining = miDecompressedSize - miDecodedSize;
+    liBlockSize = liRemaining < miBlockSize ? liRemaining : miBlockSize;
+
+    if( liStoredSize & kiStoredBlockFlag )
+    {
+        if( liSourceSize != liBlockSize )
+        {
+            return false;
+        }
+        memcpy( lpOutput, mpDataPtr, liBlockSize );
+    }
+    else if( !cBlockCompressor::DecompressBlock( (const uint8_t*)mpDataPtr, liSourceSize, (uint8_t*)lpOutput, liBlockSize ) )
+    {
+        return false;
+    }
+
+    mpDataPtr += liSourceSize;
+    miDecodedSize += liBlockSize;
+    return true;
+}
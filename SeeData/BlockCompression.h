@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Optional compressed container for binary files, built from independent LZ4 style blocks so it can be decoded
+// either straight into a parse buffer or a block at a time.
+//
+//   "SDZ1"                       magic
+//   uint32                       decompressed size
+//   uint32                       block size
+//   { uint32 size, bytes }...    one entry per block, the top bit of size is set for blocks stored uncompressed
+//
+// Blocks use the LZ4 block format: a token of literal and match lengths, extra length bytes, the literals, then a
+// 16 bit match offset. Nothing outside this file depends on that.
+class cBlockCompressor
+{
+public:
+    static constexpr size_t kiBlockSize = 64 * 1024;
+    static constexpr size_t kiHeaderSize = 12;
+
+    static bool   IsCompressed( const char* lpData, size_t liDataSize );
+
+    // Returns 0 if lpData doesn't start with a valid header, or claims more data than its blocks could hold
+    static size_t GetDecompressedSize( const char* lpData, size_t liDataSize );
+
+    static void   Compress( const char* lpData, size_t liDataSize, std::vector< char >& lOutput );
+
+    // lpOutput must hold GetDecompressedSize() bytes
+    static bool   Decompress( const char* lpData, size_t liDataSize, char* lpOutput, size_t liOutputSize );
+
+    static size_t CompressBlock( const uint8_t* lpSource, size_t liSourceSize, uint8_t* lpOutput );
+    static bool   DecompressBlock( const uint8_t* lpSource, size_t liSourceSize, uint8_t* lpOutput, size_t liOutputSize );
+
+    static size_t GetCompressedBlockBound( size_t liSourceSize )
+    {
+        return liSourceSize + liSourceSize / 255 + 16;
+    }
+};
+
+// Walks a compressed container one block at a time, for streaming without holding the whole decompressed file
+class cBlockDecoder
+{
+public:
+    cBlockDecoder( const char* lpData, size_t liDataSize );
+
+    bool IsValid() const
+    {
+        return mbValid;
+    }
+
+    bool IsFinished() const
+    {
+        return miDecodedSize == miDecompressedSize;
+    }
+
+    size_t GetDecompressedSize() const
+    {
+        return miDecompressedSize;
+    }
+
+    // Decodes the next block into lpOutput, which must hold cBlockCompressor::kiBlockSize bytes
+    bool NextBlock( char* lpOutput, size_t& liBlockSize );
+
+private:
+    const char* mpDataPtr;
+    const char* mpDataEnd;
+    size_t      miDecompressedSize;
+    size_t      miDecodedSize;
+    size_t      miBlockSize;
+    bool        mbValid;
+};
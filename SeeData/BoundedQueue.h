@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Blocking multi-producer, multi-consumer queue holding at most miCapacity items, used to link pipeline stages.
+// Producers block while it's full, which keeps a fast stage from running too far ahead of a slow one.
+template < typename T >
+class cBoundedQueue
+{
+public:
+    explicit cBoundedQueue( size_t liCapacity ) : miCapacity( liCapacity ) {}
+
+    // Returns false if the queue has been closed
+    bool Push( T lItem )
+    {
+        std::unique_lock< std::mutex > lLock( mMutex );
+        mNotFull.wait( lLock, [ this ] { return mbClosed || maItems.size() < miCapacity; } );
+        if( mbClosed )
+        {
+            return false;
+        }
+
+        maItems.push_back( std::move( lItem ) );
+        mNotEmpty.notify_one();
+        return true;
+    }
+
+    // Returns false once the queue has been closed and drained
+    bool Pop( T& lItem )
+    {
+        std::unique_lock< std::mutex > lLock( mMutex );
+        mNotEmpty.wait( lLock, [ this ] { return mbClosed || !maItems.empty(); } );
+        return PopLocked( lItem );
+    }
+
+    bool TryPop( T& lItem )
+    {
+        std::lock_guard< std::mutex > lLock( mMutex );
+        return PopLocked( lItem );
+    }
+
+    bool IsFinished() const
+    {
+        std::lock_guard< std::mutex > lLock( mMutex );
+        return mbClosed && maItems.empty();
+    }
+
+    // No more items will be pushed, consumers drain what's left and then stop
+    void Close()
+    {
+        std::lock_guard< std::mutex > lLock( mMutex );
+        mbClosed = true;
+        mNotEmpty.notify_all();
+        mNotFull.notify_all();
+    }
+
+private:
+    bool PopLocked( T& lItem )
+    {
+        if( maItems.empty() )
+        {
+            return false;
+        }
+
+        lItem = std::move( maItems.front() );
+        maItems.pop_front();
+        mNotFull.notify_one();
+        return true;
+    }
+
+    mutable std::mutex      mMutex;
+    std::condition_variable mNotEmpty;
+    std::condition_variable mNotFull;
+    std::deque< T >         maItems;
+    size_t                  miCapacity;
+    bool                    mbClosed = false;
+};
@@ -0,0 +1,561 @@
+#include "CorpusIndex.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <unordered_map>
+#include "BinaryUtil.h"
+#include "BlockCompression.h"
+#include "DataReader.h"
+#include "Platform.h"
+
+namespace
+{
+    const char kaMagic[ 4 ] = { 'S', 'D', 'I', '1' };
+}
+
+bool cCorpusIndex::Open( const std::string& lDirectory )
+{
+    mpError = nullptr;
+    miNumFiles = 0;
+    miNumTokens = 0;
+
+    std::string lIndexFilename = ( std::filesystem::path( lDirectory ) / kpIndexFilename ).string();
+    if( !mFile.Open( lIndexFilename.c_str(), false ) )
+    {
+        return Fail( "No index found, run --index on the directory first" );
+    }
+
+    const char* lpData = mFile.GetData();
+    size_t liDataSize = mFile.GetSize();
+    if( liDataSize < kiHeaderSize || memcmp( lpData, kaMagic, sizeof( kaMagic ) ) != 0 )
+    {
+        return Fail( "Not an index file" );
+    }
+
+    uint32_t laCounts[ 5 ];
+    memcpy( laCounts, lpData + sizeof( kaMagic ), sizeof( laCounts ) );
+    uint32_t liNumFiles = laCounts[ 0 ];
+    uint32_t liNumKeyPaths = laCounts[ 1 ];
+    uint32_t liNumTokens = laCounts[ 2 ];
+    uint32_t liNumPostings = laCounts[ 3 ];
+    uint32_t liStringsSize = laCounts[ 4 ];
+
+    uint64_t liExpectedSize = kiHeaderSize +
+                              (uint64_t)liNumFiles * sizeof( sFile ) +
+                              (uint64_t)liNumKeyPaths * sizeof( sString ) +
+                              (uint64_t)liNumTokens * sizeof( sToken ) +
+                              (uint64_t)liNumPostings * sizeof( sPosting ) +
+                              liStringsSize;
+    if( liExpectedSize != liDataSize )
+    {
+        return Fail( "Index file is truncated or corrupt" );
+    }
+
+    mpFiles = (const sFile*)( lpData + kiHeaderSize );
+    mpKeyPaths = (const sString*)( mpFiles + liNumFiles );
+    mpTokens = (const sToken*)( mpKeyPaths + liNumKeyPaths );
+    mpPostings = (const sPosting*)( mpTokens + liNumTokens );
+    mpStrings = (const char*)( mpPostings + liNumPostings );
+
+    // Everything a search can reach is checked once here, so searches can trust the tables
+    auto IsValidString = [ liStringsSize ]( uint32_t liOffset, uint32_t liLength )
+    {
+        return (uint64_t)liOffset + liLength <= liStringsSize;
+    };
+
+    for( uint32_t ii = 0; ii < liNumFiles; ++ii )
+    {
+        if( !IsValidString( mpFiles[ ii ].miNameOffset, mpFiles[ ii ].miNameLength ) || mpFiles[ ii ].miState > EFileState_Failed )
+        {
+            return Fail( "Index file is corrupt" );
+        }
+    }
+    for( uint32_t ii = 0; ii < liNumKeyPaths; ++ii )
+    {
+        if( !IsValidString( mpKeyPaths[ ii ].miOffset, mpKeyPaths[ ii ].miLength ) )
+        {
+            return Fail( "Index file is corrupt" );
+        }
+    }
+    for( uint32_t ii = 0; ii < liNumTokens; ++ii )
+    {
+        const sToken& lToken = mpTokens[ ii ];
+        if( !IsValidString( lToken.miOffset, lToken.miLength ) || (uint64_t)lToken.miFirstPosting + lToken.miNumPostings > liNumPostings )
+        {
+            return Fail( "Index file is corrupt" );
+        }
+    }
+    for( uint32_t ii = 0; ii < liNumPostings; ++ii )
+    {
+        if( mpPostings[ ii ].miFile >= liNumFiles || mpPostings[ ii ].miKeyPath >= liNumKeyPaths )
+        {
+            return Fail( "Index file is corrupt" );
+        }
+    }
+
+    miNumFiles = liNumFiles;
+    miNumTokens = liNumTokens;
+    return true;
+}
+
+void cCorpusIndex::Search( std::string_view lQuery, std::vector< sMatch >& laMatches ) const
+{
+    bool lbPrefix = !lQuery.empty() && lQuery.back() == '*';
+    if( lbPrefix )
+    {
+        lQuery.remove_suffix( 1 );
+    }
+
+    // First token not less than the query
+    uint32_t liFirst = 0;
+    uint32_t liCount = miNumTokens;
+    while( liCount > 0 )
+    {
+        uint32_t liStep = liCount / 2;
+        if( GetTokenString( liFirst + liStep ) < lQuery )
+        {
+            liFirst += liStep + 1;
+            liCount -= liStep + 1;
+        }
+        else
+        {
+            liCount = liStep;
+        }
+    }
+
+    for( uint32_t liToken = liFirst; liToken < miNumTokens; ++liToken )
+    {
+        std::string_view lToken = GetTokenString( liToken );
+        if( lbPrefix ? lToken.substr( 0, lQuery.length() ) != lQuery : lToken != lQuery )
+        {
+            break;
+        }
+        AddMatches( liToken, laMatches );
+    }
+}
+
+void cCorpusIndex::AddMatches( uint32_t liToken, std::vector< sMatch >& laMatches ) const
+{
+    const sToken& lToken = mpTokens[ liToken ];
+    for( uint32_t ii = 0; ii < lToken.miNumPostings; ++ii )
+    {
+        const sPosting& lPosting = mpPostings[ lToken.miFirstPosting + ii ];
+        laMatches.push_back( { GetTokenString( liToken ), GetFilename( lPosting.miFile ), GetKeyPath( lPosting.miKeyPath ) } );
+    }
+}
+
+bool cCorpusIndex::Fail( const char* lpError )
+{
+    mpError = lpError;
+    miNumFiles = 0;
+    miNumTokens = 0;
+    return false;
+}
+
+bool cCorpusIndexBuilder::Update( const std::string& lDirectory, std::string& lError )
+{
+    namespace fs = std::filesystem;
+
+    mStats = sIndexStats();
+    maPreviousFiles.clear();
+    maFiles.clear();
+
+    // The previous index is copied out and unmapped, so it can be replaced
+    {
+        cCorpusIndex lPrevious;
+        if( lPrevious.Open( lDirectory ) )
+        {
+            LoadPrevious( lPrevious );
+        }
+    }
+
+    std::error_code lErrorCode;
+    fs::path lRoot( lDirectory );
+    fs::recursive_directory_iterator lIterator( lRoot, fs::directory_options::skip_permission_denied, lErrorCode );
+    if( lErrorCode )
+    {
+        lError = "Error reading directory \"" + lDirectory + "\": " + lErrorCode.message();
+        return false;
+    }
+
+    std::string lIndexFilename = cCorpusIndex::kpIndexFilename;
+    for( ; lIterator != fs::recursive_directory_iterator(); lIterator.increment( lErrorCode ) )
+    {
+        if( lErrorCode )
+        {
+            lError = "Error reading directory \"" + lDirectory + "\": " + lErrorCode.message();
+            return false;
+        }
+
+        const fs::directory_entry& lDirectoryEntry = *lIterator;
+        if( !lDirectoryEntry.is_regular_file( lErrorCode ) )
+        {
+            continue;
+        }
+
+        sFileEntry lEntry;
+        lEntry.mFilename = lDirectoryEntry.path().lexically_relative( lRoot ).generic_string();
+        if( lEntry.mFilename.compare( 0, lIndexFilename.length(), lIndexFilename ) == 0 )
+        {
+            continue;
+        }
+
+        lEntry.miSize = lDirectoryEntry.file_size( lErrorCode );
+        lEntry.miModifiedTime = (uint64_t)lDirectoryEntry.last_write_time( lErrorCode ).time_since_epoch().count();
+        maFiles.push_back( std::move( lEntry ) );
+    }
+
+    auto IsBefore = []( const sFileEntry& lA, const sFileEntry& lB )
+    {
+        return lA.mFilename < lB.mFilename;
+    };
+    std::sort( maFiles.begin(), maFiles.end(), IsBefore );
+
+    // Files that haven't been touched since the last index keep their tokens without being read
+    std::vector< size_t > laToIndex;
+    for( size_t ii = 0; ii < maFiles.size(); ++ii )
+    {
+        sFileEntry& lEntry = maFiles[ ii ];
+        auto lPrevious = std::lower_bound( maPreviousFiles.begin(), maPreviousFiles.end(), lEntry, IsBefore );
+        if( lPrevious != maPreviousFiles.end() && lPrevious->mFilename == lEntry.mFilename )
+        {
+            lEntry.mpPrevious = &*lPrevious;
+            if( lPrevious->miModifiedTime == lEntry.miModifiedTime && lPrevious->miSize == lEntry.miSize )
+            {
+                lEntry.miHash = lPrevious->miHash;
+                lEntry.meState = lPrevious->meState;
+                lEntry.mbUnchanged = true;
+                lEntry.maTokens = std::move( lPrevious->maTokens );
+                continue;
+            }
+        }
+        laToIndex.push_back( ii );
+    }
+
+    unsigned int liNumThreads = std::thread::hardware_concurrency();
+    if( liNumThreads == 0 )
+    {
+        liNumThreads = 4;
+    }
+    if( liNumThreads > laToIndex.size() )
+    {
+        liNumThreads = (unsigned int)laToIndex.size();
+    }
+
+    std::atomic< size_t > liNextFile( 0 );
+    std::vector< std::thread > laThreads;
+    for( unsigned int ii = 0; ii < liNumThreads; ++ii )
+    {
+        laThreads.emplace_back( [ & ]
+        {
+            for( size_t liFile = liNextFile++; liFile < laToIndex.size(); liFile = liNextFile++ )
+            {
+                IndexFile( lDirectory, maFiles[ laToIndex[ liFile ] ] );
+            }
+        } );
+    }
+
+    for( std::thread& lThread : laThreads )
+    {
+        lThread.join();
+    }
+
+    mStats.miNumFiles = (int)maFiles.size();
+    for( const sFileEntry& lEntry : maFiles )
+    {
+        switch( lEntry.meState )
+        {
+            case cCorpusIndex::EFileState_Parsed:
+                if( lEntry.mbUnchanged )
+                {
+                    ++mStats.miNumUnchanged;
+                }
+                else
+                {
+                    ++mStats.miNumParsed;
+                }
+                break;
+
+            case cCorpusIndex::EFileState_NotData: ++mStats.miNumNotData; break;
+            case cCorpusIndex::EFileState_Failed:  ++mStats.miNumFailed;  break;
+        }
+    }
+
+    return Write( lDirectory, lError );
+}
+
+void cCorpusIndexBuilder::LoadPrevious( const cCorpusIndex& lPrevious )
+{
+    maPreviousFiles.resize( lPrevious.GetNumFiles() );
+    for( uint32_t ii = 0; ii < lPrevious.GetNumFiles(); ++ii )
+    {
+        const cCorpusIndex::sFile& lFile = lPrevious.GetFile( ii );
+        sFileEntry& lEntry = maPreviousFiles[ ii ];
+        lEntry.mFilename = lPrevious.GetFilename( ii );
+        lEntry.miModifiedTime = lFile.miModifiedTime;
+        lEntry.miSize = lFile.miSize;
+        lEntry.miHash = lFile.miHash;
+        lEntry.meState = (cCorpusIndex::eFileState)lFile.miState;
+    }
+
+    for( uint32_t ii = 0; ii < lPrevious.GetNumTokens(); ++ii )
+    {
+        const cCorpusIndex::sToken& lToken = lPrevious.GetToken( ii );
+        for( uint32_t jj = 0; jj < lToken.miNumPostings; ++jj )
+        {
+            const cCorpusIndex::sPosting& lPosting = lPrevious.GetPosting( lToken.miFirstPosting + jj );
+            maPreviousFiles[ lPosting.miFile ].maTokens.push_back( { std::string( lPrevious.GetTokenString( ii ) ), std::string( lPrevious.GetKeyPath( lPosting.miKeyPath ) ) } );
+        }
+    }
+}
+
+void cCorpusIndexBuilder::IndexFile( const std::string& lDirectory, sFileEntry& lEntry ) const
+{
+    lEntry.maTokens.clear();
+    lEntry.miHash = 0;
+    lEntry.mbUnchanged = false;
+
+    std::string lFilename = ( std::filesystem::path( lDirectory ) / lEntry.mFilename ).string();
+    cMappedFile lFile;
+    if( !lFile.Open( lFilename.c_str(), false ) )
+    {
+        lEntry.meState = cCorpusIndex::EFileState_Failed;
+        return;
+    }
+
+    // Only the first bytes of files that aren't data are read
+    const char* lpData = lFile.GetData();
+    size_t liDataSize = lFile.GetSize();
+    bool lbCompressed = cBlockCompressor::IsCompressed( lpData, liDataSize );
+    if( !lbCompressed && !cDataReader::IsBinaryData( lpData, liDataSize ) )
+    {
+        lEntry.meState = cCorpusIndex::EFileState_NotData;
+        return;
+    }
+
+    // Hashed to spot files that were touched without being changed
+    lEntry.miHash = HashFnv1a( lpData, liDataSize );
+    if( lEntry.mpPrevious && lEntry.mpPrevious->miHash == lEntry.miHash )
+    {
+        lEntry.maTokens = std::move( lEntry.mpPrevious->maTokens );
+        lEntry.meState = lEntry.mpPrevious->meState;
+        lEntry.mbUnchanged = true;
+        return;
+    }
+
+    std::vector< char > laDecompressed;
+    if( lbCompressed )
+    {
+        laDecompressed.resize( cBlockCompressor::GetDecompressedSize( lpData, liDataSize ) );
+        if( laDecompressed.empty() || !cBlockCompressor::Decompress( lpData, liDataSize, laDecompressed.data(), laDecompressed.size() ) )
+        {
+            lEntry.meState = cCorpusIndex::EFileState_Failed;
+            return;
+        }
+        lpData = laDecompressed.data();
+        liDataSize = laDecompressed.size();
+    }
+
+    if( !cDataReader::IsBinaryData( lpData, liDataSize ) || !CollectTokens( lpData + 1, liDataSize - 1, lEntry.maTokens ) )
+    {
+        lEntry.maTokens.clear();
+        lEntry.meState = cCorpusIndex::EFileState_Failed;
+        return;
+    }
+
+    lEntry.meState = cCorpusIndex::EFileState_Parsed;
+}
+
+bool cCorpusIndexBuilder::CollectTokens( const char* lpData, size_t liDataSize, std::vector< sFileToken >& laTokens )
+{
+    struct sArrayState
+    {
+        size_t miKeyPathLength;
+        int    miNumChildren;
+    };
+
+    sArrayState laArrays[ cDataReader::kiMaxDepth ];
+    std::string lKeyPath;
+
+    cDataReader lReader( lpData, liDataSize );
+    for( eReadEvent leEvent = lReader.Next(); leEvent != EReadEvent_EndOfStream; leEvent = lReader.Next() )
+    {
+        int liDepth = lReader.GetDepth();
+        switch( leEvent )
+        {
+            case EReadEvent_BeginArray:
+                if( liDepth > 1 )
+                {
+                    ++laArrays[ liDepth - 2 ].miNumChildren;
+                }
+                laArrays[ liDepth - 1 ] = { lKeyPath.length(), 0 };
+                break;
+
+            case EReadEvent_Value:
+            {
+                sArrayState& lArray = laArrays[ liDepth - 1 ];
+                std::string_view lString = lReader.GetString();
+                if( IsStringType( lReader.GetNodeType() ) && !lString.empty() )
+                {
+                    // An array's key is part of its own path, the root array has none
+                    if( lArray.miNumChildren == 0 && liDepth > 1 && IsKeyType( lReader.GetNodeType() ) )
+                    {
+                        if( !lKeyPath.empty() )
+                        {
+                            lKeyPath += '/';
+                        }
+                        lKeyPath += lString;
+                    }
+                    laTokens.push_back( { std::string( lString ), lKeyPath } );
+                }
+                ++lArray.miNumChildren;
+                break;
+            }
+
+            case EReadEvent_EndArray:
+                lKeyPath.resize( laArrays[ liDepth ].miKeyPathLength );
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    std::sort( laTokens.begin(), laTokens.end() );
+    laTokens.erase( std::unique( laTokens.begin(), laTokens.end() ), laTokens.end() );
+    return true;
+}
+
+bool cCorpusIndexBuilder::Write( const std::string& lDirectory, std::string& lError )
+{
+    struct sTokenPosting
+    {
+        std::string_view mToken;
+        uint32_t         miFile;
+        uint32_t         miKeyPath;
+    };
+
+    std::vector< char > laStrings;
+    auto AddString = [ &laStrings ]( std::string_view lString )
+    {
+        cCorpusIndex::sString lResult = { (uint32_t)laStrings.size(), (uint32_t)lString.length() };
+        laStrings.insert( laStrings.end(), lString.begin(), lString.end() );
+        return lResult;
+    };
+
+    std::unordered_map< std::string_view, uint32_t > lKeyPathIds;
+    std::vector< std::string_view > laKeyPaths;
+    std::vector< sTokenPosting > laPostings;
+    for( uint32_t ii = 0; ii < (uint32_t)maFiles.size(); ++ii )
+    {
+        for( const sFileToken& lToken : maFiles[ ii ].maTokens )
+        {
+            auto lKeyPathId = lKeyPathIds.emplace( lToken.mKeyPath, (uint32_t)laKeyPaths.size() );
+            if( lKeyPathId.second )
+            {
+                laKeyPaths.push_back( lToken.mKeyPath );
+            }
+            laPostings.push_back( { lToken.mToken, ii, lKeyPathId.first->second } );
+        }
+    }
+
+    std::sort( laPostings.begin(), laPostings.end(), []( const sTokenPosting& lA, const sTokenPosting& lB )
+    {
+        if( lA.mToken != lB.mToken )
+        {
+            return lA.mToken < lB.mToken;
+        }
+        return lA.miFile != lB.miFile ? lA.miFile < lB.miFile : lA.miKeyPath < lB.miKeyPath;
+    } );
+
+    std::vector< cCorpusIndex::sFile > laFileTable;
+    for( const sFileEntry& lEntry : maFiles )
+    {
+        cCorpusIndex::sString lName = AddString( lEntry.mFilename );
+        laFileTable.push_back( { lName.miOffset, lName.miLength, lEntry.miModifiedTime, lEntry.miSize, lEntry.miHash, (uint32_t)lEntry.meState, 0 } );
+    }
+
+    std::vector< cCorpusIndex::sString > laKeyPathTable;
+    for( std::string_view lKeyPath : laKeyPaths )
+    {
+        laKeyPathTable.push_back( AddString( lKeyPath ) );
+    }
+
+    std::vector< cCorpusIndex::sToken > laTokenTable;
+    for( size_t ii = 0; ii < laPostings.size(); ++ii )
+    {
+        if( laTokenTable.empty() || laPostings[ ii ].mToken != laPostings[ ii - 1 ].mToken )
+        {
+            cCorpusIndex::sString lToken = AddString( laPostings[ ii ].mToken );
+            laTokenTable.push_back( { lToken.miOffset, lToken.miLength, (uint32_t)ii, 0 } );
+        }
+        ++laTokenTable.back().miNumPostings;
+    }
+
+    if( laStrings.size() > UINT32_MAX || laPostings.size() > UINT32_MAX )
+    {
+        lError = "Too much data for an index";
+        return false;
+    }
+
+    mStats.miNumTokens = laTokenTable.size();
+    mStats.miNumPostings = laPostings.size();
+
+    std::vector< char > laOutput;
+    laOutput.insert( laOutput.end(), kaMagic, kaMagic + sizeof( kaMagic ) );
+    Append< uint32_t >( laOutput, (uint32_t)laFileTable.size() );
+    Append< uint32_t >( laOutput, (uint32_t)laKeyPathTable.size() );
+    Append< uint32_t >( laOutput, (uint32_t)laTokenTable.size() );
+    Append< uint32_t >( laOutput, (uint32_t)laPostings.size() );
+    Append< uint32_t >( laOutput, (uint32_t)laStrings.size() );
+
+    for( const cCorpusIndex::sFile& lFile : laFileTable )
+    {
+        Append( laOutput, lFile );
+    }
+    for( const cCorpusIndex::sString& lKeyPath : laKeyPathTable )
+    {
+        Append( laOutput, lKeyPath );
+    }
+    for( const cCorpusIndex::sToken& lToken : laTokenTable )
+    {
+        Append( laOutput, lToken );
+    }
+    for( const sTokenPosting& lPosting : laPostings )
+    {
+        Append( laOutput, cCorpusIndex::sPosting { lPosting.miFile, lPosting.miKeyPath } );
+    }
+    laOutput.insert( laOutput.end(), laStrings.begin(), laStrings.end() );
+
+    // Written alongside and then renamed over the old index, so a search never sees half of one
+    std::filesystem::path lIndexPath = std::filesystem::path( lDirectory ) / cCorpusIndex::kpIndexFilename;
+    std::filesystem::path lTempPath = lIndexPath;
+    lTempPath += ".tmp";
+
+    FILE* lpOutputFile = nullptr;
+    fopen_s( &lpOutputFile, lTempPath.string().c_str(), "wb" );
+    if( !lpOutputFile )
+    {
+        lError = "Error opening file \"" + lTempPath.string() + "\" for writing";
+        return false;
+    }
+
+    bool lbWritten = fwrite( laOutput.data(), laOutput.size(), 1, lpOutputFile ) == 1;
+    fclose( lpOutputFile );
+
+    std::error_code lErrorCode;
+    if( lbWritten )
+    {
+        std::filesystem::rename( lTempPath, lIndexPath, lErrorCode );
+    }
+    if( !lbWritten || lErrorCode )
+    {
+        std::filesystem::remove( lTempPath, lErrorCode );
+        lError = "Error writing index \"" + lIndexPath.string() + "\"";
+        return false;
+    }
+
+    return true;
+}
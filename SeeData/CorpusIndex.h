@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+
+// Inverted index over the binary data files under a directory, from every string in them ( keys, values, include
+// paths ) to the files and key paths it appears at. A key path names the arrays holding the string by their first
+// strings, as in patch scripts. The index lives in the directory and is searched straight from a memory mapping:
+//
+//   "SDI1"                                             magic
+//   uint32 x 5                                         files, key paths, tokens, postings, string data size
+//   { uint32 name offset, name length,
+//     uint64 modified time, size, content hash,
+//     uint32 state, unused } x files
+//   { uint32 offset, length } x key paths
+//   { uint32 offset, length,
+//     first posting, number of postings } x tokens     sorted, for binary search
+//   { uint32 file, key path } x postings
+//   bytes                                              filenames, key paths and tokens
+class cCorpusIndex
+{
+public:
+    static constexpr const char* kpIndexFilename = "seedata.sdi";
+    static constexpr size_t      kiHeaderSize = 24;
+
+    // What was found when a file was last read, kept so files that are skipped as unchanged still report it
+    enum eFileState {
+        EFileState_Parsed,
+        EFileState_NotData,
+        EFileState_Failed,
+    };
+
+    struct sFile
+    {
+        uint32_t miNameOffset;
+        uint32_t miNameLength;
+        uint64_t miModifiedTime;
+        uint64_t miSize;
+        uint64_t miHash;
+        uint32_t miState;
+        uint32_t miUnused;
+    };
+
+    struct sString
+    {
+        uint32_t miOffset;
+        uint32_t miLength;
+    };
+
+    struct sToken
+    {
+        uint32_t miOffset;
+        uint32_t miLength;
+        uint32_t miFirstPosting;
+        uint32_t miNumPostings;
+    };
+
+    struct sPosting
+    {
+        uint32_t miFile;
+        uint32_t miKeyPath;
+    };
+
+    struct sMatch
+    {
+        std::string_view mToken;
+        std::string_view mFilename;
+        std::string_view mKeyPath;
+    };
+
+    // Maps the index in lDirectory
+    bool Open( const std::string& lDirectory );
+
+    // Finds lQuery exactly, or every token starting with it when it ends in *
+    void Search( std::string_view lQuery, std::vector< sMatch >& laMatches ) const;
+
+    uint32_t GetNumFiles() const
+    {
+        return miNumFiles;
+    }
+
+    const sFile& GetFile( uint32_t liFile ) const
+    {
+        return mpFiles[ liFile ];
+    }
+
+    uint32_t GetNumTokens() const
+    {
+        return miNumTokens;
+    }
+
+    const sToken& GetToken( uint32_t liToken ) const
+    {
+        return mpTokens[ liToken ];
+    }
+
+    const sPosting& GetPosting( uint32_t liPosting ) const
+    {
+        return mpPostings[ liPosting ];
+    }
+
+    std::string_view GetFilename( uint32_t liFile ) const
+    {
+        return std::string_view( mpStrings + mpFiles[ liFile ].miNameOffset, mpFiles[ liFile ].miNameLength );
+    }
+
+    std::string_view GetKeyPath( uint32_t liKeyPath ) const
+    {
+        return std::string_view( mpStrings + mpKeyPaths[ liKeyPath ].miOffset, mpKeyPaths[ liKeyPath ].miLength );
+    }
+
+    std::string_view GetTokenString( uint32_t liToken ) const
+    {
+        return std::string_view( mpStrings + mpTokens[ liToken ].miOffset, mpTokens[ liToken ].miLength );
+    }
+
+    const char* GetError() const
+    {
+        return mpError;
+    }
+
+private:
+    bool Fail( const char* lpError );
+    void AddMatches( uint32_t liToken, std::vector< sMatch >& laMatches ) const;
+
+    cMappedFile     mFile;
+    const sFile*    mpFiles = nullptr;
+    const sString*  mpKeyPaths = nullptr;
+    const sToken*   mpTokens = nullptr;
+    const sPosting* mpPostings = nullptr;
+    const char*     mpStrings = nullptr;
+    uint32_t        miNumFiles = 0;
+    uint32_t        miNumTokens = 0;
+    const char*     mpError = nullptr;
+};
+
+struct sIndexStats
+{
+    int    miNumFiles = 0;
+    int    miNumParsed = 0;
+    int    miNumUnchanged = 0;
+    int    miNumNotData = 0;
+    int    miNumFailed = 0;
+    size_t miNumTokens = 0;
+    size_t miNumPostings = 0;
+};
+
+// Builds or updates the index for a directory. Files whose modified time and size match the previous index are
+// kept without being read, and files whose contents hash the same are kept without being parsed. Everything else
+// is parsed in parallel. Files kept from the previous index count as unchanged only if they were data that parsed,
+// otherwise they count as not data or failed again.
+class cCorpusIndexBuilder
+{
+public:
+    bool Update( const std::string& lDirectory, std::string& lError );
+
+    const sIndexStats& GetStats() const
+    {
+        return mStats;
+    }
+
+private:
+    struct sFileToken
+    {
+        std::string mToken;
+        std::string mKeyPath;
+
+        bool operator<( const sFileToken& lOther ) const
+        {
+            return mToken != lOther.mToken ? mToken < lOther.mToken : mKeyPath < lOther.mKeyPath;
+        }
+
+        bool operator==( const sFileToken& lOther ) const
+        {
+            return mToken == lOther.mToken && mKeyPath == lOther.mKeyPath;
+        }
+    };
+
+    struct sFileEntry
+    {
+        std::string               mFilename;
+        uint64_t                  miModifiedTime = 0;
+        uint64_t                  miSize = 0;
+        uint64_t                  miHash = 0;
+        cCorpusIndex::eFileState  meState = cCorpusIndex::EFileState_Parsed;
+        bool                      mbUnchanged = false;
+        std::vector< sFileToken > maTokens;
+
+        // From the previous index, when the file was in it
+        sFileEntry*               mpPrevious = nullptr;
+    };
+
+    void LoadPrevious( const cCorpusIndex& lPrevious );
+    void IndexFile( const std::string& lDirectory, sFileEntry& lEntry ) const;
+    bool Write( const std::string& lDirectory, std::string& lError );
+
+    static bool CollectTokens( const char* lpData, size_t liDataSize, std::vector< sFileToken >& laTokens );
+
+    std::vector< sFileEntry > maPreviousFiles;
+    std::vector< sFileEntry > maFiles;
+    sIndexStats               mStats;
+};
@@ -1,6 +1,35 @@
 #include "DataFile.h"
+#include "BlockCompression.h"
+#include <climits>
+#include <cstring>
 #include <iostream>
-#include <vector>
+
+namespace
+{
+    // Binary files count an array's children with a signed short, but text files have no such limit
+    bool FitsBinaryFormat( const cDataNode* lpNode )
+    {
+        if( !IsArrayType( lpNode->GetNodeType() ) )
+        {
+            return true;
+        }
+
+        const cDataNodeArray* lpArray = static_cast< const cDataNodeArray* >( lpNode );
+        if( lpArray->GetNumChildren() > SHRT_MAX )
+        {
+            return false;
+        }
+
+        for( int ii = 0; ii < lpArray->GetNumChildren(); ++ii )
+        {
+            if( !FitsBinaryFormat( lpArray->GetChild( ii ) ) )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
 
 cDtaFile::cDtaFile( const char* lpFilename )
     : miDataSize( 0 )
@@ -26,6 +55,15 @@ cDtaFile::cDtaFile( const char* lpFilename )
     ParseData();
 }
 
+cDtaFile::cDtaFile( const char* lpData, int liDataSize )
+    : miDataSize( liDataSize )
+    , mpData( new char[ liDataSize ] )
+    , mpRootNode( nullptr )
+{
+    memcpy( mpData, lpData, liDataSize );
+    ParseData();
+}
+
 cDtaFile::~cDtaFile()
 {
     delete mpRootNode;
@@ -34,11 +72,48 @@ cDtaFile::~cDtaFile()
 
 void cDtaFile::ParseData()
 {
+    delete mpRootNode;
+    mpRootNode = nullptr;
+    cDataNodeArray::msNextNodeId = 1;
+
+    if( miDataSize <= 0 )
+    {
+        mLastError = "File is empty";
+        return;
+    }
+
+    if( cBlockCompressor::IsCompressed( mpData, miDataSize ) )
+    {
+        size_t liDecompressedSize = cBlockCompressor::GetDecompressedSize( mpData, miDataSize );
+        if( liDecompressedSize > INT_MAX )
+        {
+            mLastError = "Decompressed file is too large";
+            return;
+        }
+
+        char* lpDecompressedData = new char[ liDecompressedSize ? liDecompressedSize : 1 ];
+        if( !cBlockCompressor::Decompress( mpData, miDataSize, lpDecompressedData, liDecompressedSize ) )
+        {
+            delete[] lpDecompressedData;
+            mLastError = "Failed to decompress file";
+            return;
+        }
+
+        delete[] mpData;
+        mpData = lpDecompressedData;
+        miDataSize = (int)liDecompressedSize;
+        mbLoadedCompressed = true;
+
+        if( miDataSize <= 0 )
+        {
+            mLastError = "File is empty";
+            return;
+        }
+    }
+
     const char* lpDataEnd = mpData + miDataSize;
     char* lpDataPtr = mpData;
 
-    delete mpRootNode;
-
     bool lbIsBinaryFile = ( *lpDataPtr++ == 1 );
     if( lbIsBinaryFile )
     {
@@ -71,56 +146,120 @@ void cDtaFile::ParseData()
 }
 
 bool cDtaFile::SaveAsText( const char* lpFilename )
+{
+    std::vector< char > lOutput;
+    return ConvertToText( lOutput ) && WriteOutputFile( lpFilename, lOutput );
+}
+
+bool cDtaFile::SaveAsBinary( const char* lpFilename, bool lbCompress )
+{
+    std::vector< char > lOutput;
+    return ConvertToBinary( lOutput, lbCompress ) && WriteOutputFile( lpFilename, lOutput );
+}
+
+bool cDtaFile::ConvertToText( std::vector< char >& lOutput )
 {
     if( !mpRootNode )
     {
-        mLastError = "Can't save to \"" + std::string( lpFilename ) + std::string( "\", no data is loaded" );
+        mLastError = "Can't convert to text, no data is loaded";
         return false;
     }
 
-    constexpr int kiOutputBufferSize = 1024 * 1024;
-    char* lpOutput = new char[ kiOutputBufferSize ];
+    for( size_t liOutputSize = kiInitialOutputSize; liOutputSize <= kiMaxOutputSize; liOutputSize *= 2 )
+    {
+        lOutput.resize( liOutputSize );
+
+        char* lpDataPtr = lOutput.data();
+        if( mpRootNode->WriteToTextStream( lpDataPtr, lOutput.data() + lOutput.size(), 0 ) )
+        {
+            lOutput.resize( lpDataPtr - lOutput.data() );
+            return true;
+        }
+    }
+
+    mLastError = "Output buffer too small\n";
+    return false;
+}
 
-    char* lpDataPtr = lpOutput;
-    if( !mpRootNode->WriteToTextStream( lpDataPtr, lpOutput + kiOutputBufferSize, 0 ) )
+bool cDtaFile::ConvertToBinary( std::vector< char >& lOutput, bool lbCompress )
+{
+    if( !mpRootNode )
     {
-        mLastError = "Output buffer too small\n";
+        mLastError = "Can't convert to binary, no data is loaded";
         return false;
     }
 
-    FILE* lpOutputFile = nullptr;
-    fopen_s( &lpOutputFile, lpFilename, "wb" );
-    if( !lpOutputFile )
+    if( !FitsBinaryFormat( mpRootNode ) )
     {
-        mLastError = "Error opening file \"" + std::string( lpFilename ) + std::string( "\" for writing" );
+        mLastError = "Can't convert to binary, an array has more than 32767 children";
         return false;
     }
 
-    fwrite( lpOutput, lpDataPtr - lpOutput, 1, lpOutputFile );
-    fclose( lpOutputFile );
+    for( size_t liOutputSize = kiInitialOutputSize; liOutputSize <= kiMaxOutputSize; liOutputSize *= 2 )
+    {
+        lOutput.resize( liOutputSize );
 
-    delete[] lpOutput;
+        char* lpDataPtr = lOutput.data();
+        *lpDataPtr++ = 1;
 
-    return true;
+        if( mpRootNode->WriteToBinaryStream( lpDataPtr, lOutput.data() + lOutput.size() ) )
+        {
+            lOutput.resize( lpDataPtr - lOutput.data() );
+            if( lbCompress )
+            {
+                std::vector< char > lUncompressedOutput;
+                lUncompressedOutput.swap( lOutput );
+                cBlockCompressor::Compress( lUncompressedOutput.data(), lUncompressedOutput.size(), lOutput );
+            }
+            return true;
+        }
+    }
+
+    mLastError = "Output buffer too small\n";
+    return false;
 }
 
-bool cDtaFile::SaveAsBinary( const char* lpFilename )
+std::string cDtaFile::GetOutputFilename( const std::string& lInputFilename, const char* lpExtension )
 {
-    if( !mpRootNode )
+    int liSlashIndex = (int)lInputFilename.rfind( '/' );
+    int liBackslashIndex = (int)lInputFilename.rfind( '\\' );
+    int liExtensionIndex = (int)lInputFilename.rfind( '.' );
+    if( liExtensionIndex < liSlashIndex ||
+        liExtensionIndex < liBackslashIndex ||
+        liExtensionIndex < 0 )
     {
-        mLastError = "Can't save to \"" + std::string( lpFilename ) + std::string( "\", no data is loaded" );
+        liExtensionIndex = (int)lInputFilename.length();
+    }
+
+    return lInputFilename.substr( 0, liExtensionIndex ) + lpExtension;
+}
+
+bool cDtaFile::WriteOutputFile( const char* lpFilename, const std::vector< char >& lOutput )
+{
+    FILE* lpOutputFile = nullptr;
+    fopen_s( &lpOutputFile, lpFilename, "wb" );
+    if( !lpOutputFile )
+    {
+        mLastError = "Error opening file \"" + std::string( lpFilename ) + std::string( "\" for writing" );
         return false;
     }
 
-    constexpr int kiOutputBufferSize = 1024 * 1024;
-    char* lpOutput = new char[ kiOutputBufferSize ];
+    bool lbWritten = lOutput.empty() || fwrite( lOutput.data(), lOutput.size(), 1, lpOutputFile ) == 1;
+    lbWritten = fclose( lpOutputFile ) == 0 && lbWritten;
+    if( !lbWritten )
+    {
+        mLastError = "Error writing file \"" + std::string( lpFilename ) + "\"";
+        return false;
+    }
 
-    char* lpDataPtr = lpOutput;
-    *lpDataPtr++ = 1;
+    return true;
+}
 
-    if( !mpRootNode->WriteToBinaryStream( lpDataPtr, lpOutput + kiOutputBufferSize ) )
+bool cDtaFile::SaveAsJson( const char* lpFilename, bool lbNewlineDelimited )
+{
+    if( !mpRootNode )
     {
-        mLastError = "Output buffer too small\n";
+        mLastError = "Can't save to \"" + std::string( lpFilename ) + std::string( "\", no data is loaded" );
         return false;
     }
 
@@ -132,10 +271,19 @@ bool cDtaFile::SaveAsBinary( const char* lpFilename )
         return false;
     }
 
-    fwrite( lpOutput, lpDataPtr - lpOutput, 1, lpOutputFile );
+    bool lbWritten = false;
+    {
+        cJsonWriter lWriter( lpOutputFile, lbNewlineDelimited );
+        mpRootNode->WriteToJsonStream( lWriter );
+        lbWritten = lWriter.Flush();
+    }
     fclose( lpOutputFile );
 
-    delete[] lpOutput;
+    if( !lbWritten )
+    {
+        mLastError = "Error writing file \"" + std::string( lpFilename ) + std::string( "\"" );
+        return false;
+    }
 
     return true;
 }
@@ -1,12 +1,16 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "DataNode.h"
 
 class cDtaFile
 {
 public:
     cDtaFile( const char* lpFilename );
+
+    // Parses a copy of data that has already been loaded into memory
+    cDtaFile( const char* lpData, int liDataSize );
     ~cDtaFile();
 
     bool LoadedAsBinary() const
@@ -19,6 +23,16 @@ public:
         return mbLoadedAsText;
     }
 
+    bool LoadedCompressed() const
+    {
+        return mbLoadedCompressed;
+    }
+
+    cDataNode* GetRootNode() const
+    {
+        return mpRootNode;
+    }
+
     const char* GetError() const
     {
         if( mLastError.empty() )
@@ -29,10 +43,21 @@ public:
     }
 
     bool SaveAsText( const char* lpFilename );
-    bool SaveAsBinary( const char* lpFilename );
+    bool SaveAsBinary( const char* lpFilename, bool lbCompress = false );
+    bool SaveAsJson( const char* lpFilename, bool lbNewlineDelimited );
+
+    bool ConvertToText( std::vector< char >& lOutput );
+    bool ConvertToBinary( std::vector< char >& lOutput, bool lbCompress = false );
+
+    // Swaps the extension of lInputFilename for lpExtension, e.g. ".txt"
+    static std::string GetOutputFilename( const std::string& lInputFilename, const char* lpExtension );
 
 private:
+    static constexpr size_t kiInitialOutputSize = 1024 * 1024;
+    static constexpr size_t kiMaxOutputSize = 256 * 1024 * 1024;
+
     void ParseData();
+    bool WriteOutputFile( const char* lpFilename, const std::vector< char >& lOutput );
 
     std::string    mLastError;
     char* mpData;
@@ -41,5 +66,6 @@ private:
 
     bool mbLoadedAsBinary = false;
     bool mbLoadedAsText = false;
+    bool mbLoadedCompressed = false;
 };
 
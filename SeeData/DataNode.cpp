@@ -1,10 +1,13 @@
 #include "DataNode.h"
+#include <climits>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 
 std::map< std::string, eNodeType > cDataNode::sNodeNamesToTypes;
 std::map< eNodeType, std::string > cDataNode::sNodeTypesToNames;
 
-int cDataNodeArray::msNextNodeId = 1;
+thread_local int cDataNodeArray::msNextNodeId = 1;
 
 #define ValidateStreamWriteSize( size ) if( lpStreamPtr + size >= lpStreamEnd ) return false
 #define ValidateStreamWritePtr( type )  ValidateStreamWriteSize( sizeof( type ) )
@@ -80,7 +83,8 @@ cDataNode* cDataNode::Create( eNodeType leNodeType )
         case ENodeType_Id:
         case ENodeType_IncludeFile:
         case ENodeType_Define:
-            return new cDataNodeString( leNodeType );
+            // The string isn't known yet, so only a long node is sure to hold it
+            return new cDataNodeLongString( leNodeType );
 
         case ENodeType_Tree1:
         case ENodeType_Tree2:
@@ -93,25 +97,25 @@ cDataNode* cDataNode::Create( eNodeType leNodeType )
 
 void cDataNode::InitialiseNodeMaps()
 {
-    if( !sNodeNamesToTypes.empty() )
+    // Files are parsed on several threads at once in batch and patch mode
+    static std::once_flag sInitialised;
+    std::call_once( sInitialised, []
     {
-        return;
-    }
-
 #define Link( name, enumentry ) sNodeNamesToTypes[ std::string( name ) ] = enumentry; sNodeTypesToNames[ enumentry ] = std::string( name );
-    
-    Link( "int", ENodeType_Integer0 );
-    Link( "int6", ENodeType_Integer6 );
-    Link( "int8", ENodeType_Integer8 );
-    Link( "int9", ENodeType_Integer9 );
-    Link( "include", ENodeType_IncludeFile );
-    Link( "define", ENodeType_Define );
-    Link( "float", ENodeType_Float );
-    Link( "text", ENodeType_Text );
-    Link( "string", ENodeType_String );
-    Link( "id", ENodeType_Id );
-    Link( "array", ENodeType_Tree1 );
-    Link( "array_alt", ENodeType_Tree2 );
+
+        Link( "int", ENodeType_Integer0 );
+        Link( "int6", ENodeType_Integer6 );
+        Link( "int8", ENodeType_Integer8 );
+        Link( "int9", ENodeType_Integer9 );
+        Link( "include", ENodeType_IncludeFile );
+        Link( "define", ENodeType_Define );
+        Link( "float", ENodeType_Float );
+        Link( "text", ENodeType_Text );
+        Link( "string", ENodeType_String );
+        Link( "id", ENodeType_Id );
+        Link( "array", ENodeType_Tree1 );
+        Link( "array_alt", ENodeType_Tree2 );
+    } );
 }
 
 const char* cDataNode::GetValueAsString( int leNodeType, bool lbUseEnumNames )
@@ -141,7 +145,7 @@ const char* cDataNode::GetValueAsString( int leNodeType, bool lbUseEnumNames )
 
         default:
         {
-            static char laTypeBuffer[ 7 ];
+            static thread_local char laTypeBuffer[ 12 ];
             _itoa_s( leNodeType, laTypeBuffer, 10 );
             return laTypeBuffer;
         }
@@ -164,47 +168,128 @@ eNodeType cDataNode::GetNodeTypeFromString( const std::string& lString )
 
 cDataNodeArray::~cDataNodeArray()
 {
-    for( cDataNode* lpChild : maChildren )
+    cDataNode* const* lpChildren = GetChildren();
+    for( uint32_t ii = 0; ii < miNumChildren; ++ii )
     {
-        delete lpChild;
+        delete lpChildren[ ii ];
+    }
+
+    if( IsOnHeap() )
+    {
+        delete[] mpHeapChildren;
     }
 }
 
-bool cDataNodeArray::ReadFromBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd )
+void cDataNodeArray::Reserve( int liCapacity )
 {
-    int liValue = ::ReadFromBinaryStream< int >( lpStreamPtr );
-    ValidateStreamPtr;
-    if( liValue != 1 )
+    if( liCapacity <= (int)miCapacity )
     {
-        return false;
+        return;
     }
 
-    short liNumChildren = ::ReadFromBinaryStream< short >( lpStreamPtr );
-    ValidateStreamPtr;
-    maChildren.reserve( liNumChildren );
+    cDataNode** lpChildren = new cDataNode*[ liCapacity ];
+    memcpy( lpChildren, GetChildren(), miNumChildren * sizeof( cDataNode* ) );
+    if( IsOnHeap() )
+    {
+        delete[] mpHeapChildren;
+    }
 
-    msNodeId = ::ReadFromBinaryStream< short >( lpStreamPtr );
-    ValidateStreamPtr;
+    mpHeapChildren = lpChildren;
+    miCapacity = (uint32_t)liCapacity;
+}
 
-    for( short liChildIndex = 0; liChildIndex < liNumChildren; ++liChildIndex )
+void cDataNodeArray::AddChild( cDataNode* lpChild )
+{
+    if( miNumChildren == miCapacity )
     {
-        ValidateStreamPtr;
+        Reserve( (int)miCapacity * 2 );
+    }
 
-        int liNodeType = ::ReadFromBinaryStream< int >( lpStreamPtr );
-        ValidateStreamPtr;
+    const_cast< cDataNode** >( GetChildren() )[ miNumChildren++ ] = lpChild;
+}
 
-        maChildren.emplace_back( cDataNode::Create( (eNodeType)liNodeType ) );
-        if( !maChildren.back() )
-        {
-            return false;
-        }
+void cDataNodeArray::ReplaceChild( int liIndex, cDataNode* lpChild )
+{
+    cDataNode** lpChildren = const_cast< cDataNode** >( GetChildren() );
+    delete lpChildren[ liIndex ];
+    lpChildren[ liIndex ] = lpChild;
+}
 
-        maChildren.back()->ReadFromBinaryStream( lpStreamPtr, lpStreamEnd );
+void cDataNodeArray::AccumulateMemory( sNodeMemoryReport& lReport ) const
+{
+    sNodeMemoryReport::sEntry& lEntry = lReport.maEntries[ meNodeType ];
+    ++lEntry.miNumNodes;
+    lEntry.miNodeBytes += sizeof( *this );
+    if( IsOnHeap() )
+    {
+        lEntry.miHeapBytes += miCapacity * sizeof( cDataNode* );
+    }
+
+    cDataNode* const* lpChildren = GetChildren();
+    for( uint32_t ii = 0; ii < miNumChildren; ++ii )
+    {
+        lpChildren[ ii ]->AccumulateMemory( lReport );
+    }
+}
+
+bool cDataNodeArray::ReadFromBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd )
+{
+    cDataReader lReader( lpStreamPtr, lpStreamEnd - lpStreamPtr, meNodeType );
+    if( lReader.Next() != EReadEvent_BeginArray || !ReadFromReader( lReader ) )
+    {
+        return false;
     }
 
+    lpStreamPtr += lReader.GetOffset();
     return true;
 }
 
+bool cDataNodeArray::ReadFromReader( cDataReader& lReader )
+{
+    msNodeId = lReader.GetNodeId();
+    Reserve( lReader.GetNumChildren() );
+
+    for( ;; )
+    {
+        switch( lReader.Next() )
+        {
+            case EReadEvent_BeginArray:
+            case EReadEvent_Value:
+            {
+                if( IsStringType( lReader.GetNodeType() ) )
+                {
+                    std::string_view lString = lReader.GetString();
+                    AddChild( cDataNodeString::CreateFromBinaryString( lReader.GetNodeType(), lString.data(), (int)lString.length() ) );
+                    break;
+                }
+
+                cDataNode* lpChild = cDataNode::Create( lReader.GetNodeType() );
+                if( !lpChild )
+                {
+                    return false;
+                }
+
+                AddChild( lpChild );
+                if( !lpChild->ReadFromReader( lReader ) )
+                {
+                    return false;
+                }
+                break;
+            }
+
+            case EReadEvent_EndArray:
+                return true;
+
+            default:
+                if( lReader.GetError() )
+                {
+                    std::cout << "Error: " << lReader.GetError() << "\n";
+                }
+                return false;
+        }
+    }
+}
+
 bool cDataNodeArray::ReadFromTextStream( char*& lpStreamPtr, const char* lpStreamEnd )
 {
 #define GetNextTextValue( variable_name ) std::string variable_name; if( !::ReadFromTextStream( lpStreamPtr, lpStreamEnd, variable_name ) ) return false;
@@ -228,14 +313,23 @@ bool cDataNodeArray::ReadFromTextStream( char*& lpStreamPtr, const char* lpStrea
             return false;
         }
 
-        cDataNode* lpChildNode = cDataNode::Create( leNodeType );
-        if( !lpChildNode )
+        if( IsStringType( leNodeType ) )
         {
-            return false;
+            std::string lString;
+            ::ReadFromTextStream( lpStreamPtr, lpStreamEnd, lString );
+            AddChild( cDataNodeString::Create( leNodeType, lString ) );
         }
+        else
+        {
+            cDataNode* lpChildNode = cDataNode::Create( leNodeType );
+            if( !lpChildNode )
+            {
+                return false;
+            }
 
-        maChildren.push_back( lpChildNode );
-        lpChildNode->ReadFromTextStream( lpStreamPtr, lpStreamEnd );
+            AddChild( lpChildNode );
+            lpChildNode->ReadFromTextStream( lpStreamPtr, lpStreamEnd );
+        }
 
         while( lpStreamPtr < lpStreamEnd &&
               *lpStreamPtr != '\"' &&
@@ -259,18 +353,29 @@ bool cDataNodeArray::WriteToBinaryStream( char*& lpStreamPtr, const char* lpStre
     ValidateStreamWritePtr( int );
     ::WriteToBinaryStream< int >( lpStreamPtr, 1 );
 
+    // Binary files count children with a signed short
+    if( miNumChildren > SHRT_MAX )
+    {
+        return false;
+    }
+
     ValidateStreamWritePtr( short );
-    ::WriteToBinaryStream< short >( lpStreamPtr, (short)maChildren.size() );
+    ::WriteToBinaryStream< short >( lpStreamPtr, (short)miNumChildren );
 
     ValidateStreamWritePtr( short );
     ::WriteToBinaryStream< short >( lpStreamPtr, msNodeId );
 
-    for( cDataNode* lpChild : maChildren )
+    cDataNode* const* lpChildren = GetChildren();
+    for( uint32_t ii = 0; ii < miNumChildren; ++ii )
     {
+        cDataNode* lpChild = lpChildren[ ii ];
         ValidateStreamWritePtr( int );
         ::WriteToBinaryStream< int >( lpStreamPtr, lpChild->GetNodeType() );
 
-        lpChild->WriteToBinaryStream( lpStreamPtr, lpStreamEnd );
+        if( !lpChild->WriteToBinaryStream( lpStreamPtr, lpStreamEnd ) )
+        {
+            return false;
+        }
     }
 
     return true;
@@ -291,13 +396,17 @@ bool cDataNodeArray::WriteToTextStream( char*& lpStreamPtr, const char* lpStream
     {
         //DoWriteJsonlike( "id", GetValueAsString( msNodeId, false ), false, true, true );
         DoWriteJsonlike( GetValueAsString( meNodeType, true ), "[", false, false, false );
-        if( maChildren.size() )
+        if( miNumChildren )
         {
             DoWriteString( "\n" );
 
-            for( cDataNode* lpChild : maChildren )
+            cDataNode* const* lpChildren = GetChildren();
+            for( uint32_t ii = 0; ii < miNumChildren; ++ii )
             {
-                lpChild->WriteToTextStream( lpStreamPtr, lpStreamEnd, liDepth );
+                if( !lpChildren[ ii ]->WriteToTextStream( lpStreamPtr, lpStreamEnd, liDepth ) )
+                {
+                    return false;
+                }
             }
         }
 
@@ -313,6 +422,42 @@ bool cDataNodeArray::WriteToTextStream( char*& lpStreamPtr, const char* lpStream
     return true;
 }
 
+void cDataNodeArray::WriteToJsonStream( cJsonWriter& lWriter ) const
+{
+    lWriter.BeginArray( GetValueAsString( meNodeType, true ) );
+    cDataNode* const* lpChildren = GetChildren();
+    for( uint32_t ii = 0; ii < miNumChildren; ++ii )
+    {
+        lpChildren[ ii ]->WriteToJsonStream( lWriter );
+    }
+    lWriter.EndArray();
+}
+
+cDataNodeString* cDataNodeString::Create( eNodeType leNodeType, std::string_view lString )
+{
+    cDataNodeString* lpNode = lString.length() <= kiMaxShortLength
+        ? (cDataNodeString*)new cDataNodeShortString( leNodeType )
+        : (cDataNodeString*)new cDataNodeLongString( leNodeType );
+    lpNode->Assign( lString );
+    return lpNode;
+}
+
+cDataNodeString* cDataNodeString::CreateFromBinaryString( eNodeType leNodeType, const char* lpString, int liStringLength )
+{
+    // Escaping adds a character for each quote
+    int liEscapedLength = liStringLength;
+    for( int ii = 0; ii < liStringLength; ++ii )
+    {
+        liEscapedLength += lpString[ ii ] == '\"';
+    }
+
+    cDataNodeString* lpNode = liEscapedLength <= (int)kiMaxShortLength
+        ? (cDataNodeString*)new cDataNodeShortString( leNodeType )
+        : (cDataNodeString*)new cDataNodeLongString( leNodeType );
+    lpNode->SetFromBinaryString( lpString, liStringLength );
+    return lpNode;
+}
+
 bool cDataNodeString::ReadFromBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd )
 {
     int liStringLength = ::ReadFromBinaryStream< int >( lpStreamPtr );
@@ -323,34 +468,90 @@ bool cDataNodeString::ReadFromBinaryStream( char*& lpStreamPtr, const char* lpSt
         return false;
     }
 
-    char* lpString = new char[ liStringLength * 2 + 1 ];
-    char* lpStringPtr = lpString;
+    if( !SetFromBinaryString( lpStreamPtr, liStringLength ) )
+    {
+        return false;
+    }
+    lpStreamPtr += liStringLength;
+
+    ValidateStreamPtr;
+
+    return true;
+}
+
+bool cDataNodeString::ReadFromReader( cDataReader& lReader )
+{
+    std::string_view lString = lReader.GetString();
+    return SetFromBinaryString( lString.data(), (int)lString.length() );
+}
+
+bool cDataNodeString::SetFromBinaryString( const char* lpString, int liStringLength )
+{
+    int liNumQuotes = 0;
     for( int ii = 0; ii < liStringLength; ++ii )
     {
-        if( *lpStreamPtr == '\"' )
+        liNumQuotes += lpString[ ii ] == '\"';
+    }
+
+    char* lpOutput = Resize( liStringLength + liNumQuotes );
+    if( !lpOutput )
+    {
+        return false;
+    }
+
+    for( int ii = 0; ii < liStringLength; ++ii )
+    {
+        if( lpString[ ii ] == '\"' )
         {
-            *lpStringPtr++ = '\\';
+            *lpOutput++ = '\\';
         }
-        *lpStringPtr++ = *lpStreamPtr++;
+        *lpOutput++ = lpString[ ii ];
     }
+    return true;
+}
 
-    *lpStringPtr = 0;
-    mString = lpString;
-    delete[] lpString;
-
-    ValidateStreamPtr;
+bool cDataNodeString::Assign( std::string_view lString )
+{
+    char* lpOutput = Resize( lString.length() );
+    if( !lpOutput )
+    {
+        return false;
+    }
 
+    memcpy( lpOutput, lString.data(), lString.length() );
     return true;
 }
 
+std::string cDataNodeString::Unescape( std::string_view lString )
+{
+    std::string lResult;
+    lResult.reserve( lString.length() );
+    for( size_t ii = 0; ii < lString.length(); ++ii )
+    {
+        if( lString[ ii ] == '\\' && ii + 1 < lString.length() && lString[ ii + 1 ] == '\"' )
+        {
+            continue;
+        }
+        lResult += lString[ ii ];
+    }
+    return lResult;
+}
+
 bool cDataNodeString::ReadFromTextStream( char*& lpStreamPtr, const char* lpStreamEnd )
 {
-    return ::ReadFromTextStream( lpStreamPtr, lpStreamEnd, mString );
+    std::string lString;
+    if( !::ReadFromTextStream( lpStreamPtr, lpStreamEnd, lString ) )
+    {
+        return false;
+    }
+
+    return Assign( lString );
 }
 
 bool cDataNodeString::WriteToBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd ) const
 {
-    int liStringLength = mString.length();
+    std::string_view lString = GetString();
+    int liStringLength = (int)lString.length();
 
     ValidateStreamWritePtr( int );
     int* lpLengthPtr = (int*)lpStreamPtr;
@@ -363,12 +564,12 @@ bool cDataNodeString::WriteToBinaryStream( char*& lpStreamPtr, const char* lpStr
 
     for( int ii = 0; ii < liStringLength && lpStreamPtr < lpStreamEnd; ++ii )
     {
-        if( mString[ ii ] == '\\' && mString[ ii + 1 ] == '\"' )
+        if( lString[ ii ] == '\\' && ii + 1 < liStringLength && lString[ ii + 1 ] == '\"' )
         {
             (*lpLengthPtr)--;
             continue;
         }
-        *lpStreamPtr++ = mString[ ii ];
+        *lpStreamPtr++ = lString[ ii ];
     }
 
     return true;
@@ -376,5 +577,52 @@ bool cDataNodeString::WriteToBinaryStream( char*& lpStreamPtr, const char* lpStr
 
 bool cDataNodeString::WriteToTextStream( char*& lpStreamPtr, const char* lpStreamEnd, int liDepth ) const
 {
-    return WriteJsonlike( lpStreamPtr, lpStreamEnd, liDepth + 1, GetValueAsString( meNodeType, true ), mString.c_str(), true, true, true );
+    std::string lString( GetString() );
+    return WriteJsonlike( lpStreamPtr, lpStreamEnd, liDepth + 1, GetValueAsString( meNodeType, true ), lString.c_str(), true, true, true );
+}
+
+void cDataNodeString::WriteToJsonStream( cJsonWriter& lWriter ) const
+{
+    std::string lString( GetString() );
+    lWriter.WriteValue( GetValueAsString( meNodeType, true ), lString.c_str(), true );
+}
+
+char* cDataNodeShortString::Resize( size_t liLength )
+{
+    if( liLength > kiMaxShortLength )
+    {
+        return nullptr;
+    }
+
+    miShortLength = (uint8_t)liLength;
+    return maString;
+}
+
+void cDataNodeShortString::AccumulateMemory( sNodeMemoryReport& lReport ) const
+{
+    sNodeMemoryReport::sEntry& lEntry = lReport.maEntries[ meNodeType ];
+    ++lEntry.miNumNodes;
+    lEntry.miNodeBytes += sizeof( *this );
+}
+
+cDataNodeLongString::~cDataNodeLongString()
+{
+    delete[] mpString;
+}
+
+char* cDataNodeLongString::Resize( size_t liLength )
+{
+    delete[] mpString;
+    mpString = new char[ liLength + 1 ];
+    mpString[ liLength ] = 0;
+    miLength = (uint32_t)liLength;
+    return mpString;
+}
+
+void cDataNodeLongString::AccumulateMemory( sNodeMemoryReport& lReport ) const
+{
+    sNodeMemoryReport::sEntry& lEntry = lReport.maEntries[ meNodeType ];
+    ++lEntry.miNumNodes;
+    lEntry.miNodeBytes += sizeof( *this );
+    lEntry.miHeapBytes += mpString ? miLength + 1 : 0;
 }
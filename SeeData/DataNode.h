@@ -1,8 +1,16 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "DataReader.h"
+#include "JsonWriter.h"
+#include "NodeType.h"
+#include "Platform.h"
 
 template <typename T>
 static void WriteToBinaryStream( char*& lpStream, const T& lValue )
@@ -111,20 +119,17 @@ bool WriteJsonlike( char*& lpStreamPtr, const char* lpStreamEnd, int liDepth, co
 
 bool AdvanceToCharacter( char*& lpStreamPtr, const char* lpStreamEnd, char lCharacter );
 
-enum eNodeType {
-    ENodeType_Integer0 = 0,
-    ENodeType_Float = 1,
-    ENodeType_Text = 2,
-    ENodeType_String = 5,
-    ENodeType_Integer6 = 6,
-    ENodeType_Integer8 = 8,
-    ENodeType_Integer9 = 9,
-    ENodeType_Tree1 = 16,
-    ENodeType_Tree2 = 17,
-    ENodeType_Id = 18,
-    ENodeType_IncludeFile = 33,
-    ENodeType_Define = 35,
-    ENodeType_Invalid
+// Totals per node type of the memory held by loaded nodes
+struct sNodeMemoryReport
+{
+    struct sEntry
+    {
+        size_t miNumNodes = 0;
+        size_t miNodeBytes = 0;
+        size_t miHeapBytes = 0;
+    };
+
+    sEntry maEntries[ ENodeType_Invalid ];
 };
 
 class cDataNode
@@ -141,8 +146,14 @@ public:
     virtual bool ReadFromBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd ) = 0;
     virtual bool ReadFromTextStream( char*& lpStreamPtr, const char* lpStreamEnd ) = 0;
 
+    // Fills the node from the reader's current event, which must be the one that introduced this node
+    virtual bool ReadFromReader( cDataReader& lReader ) = 0;
+
     virtual bool WriteToBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd ) const = 0;
     virtual bool WriteToTextStream( char*& lpStreamPtr, const char* lpStreamEnd, int liDepth ) const = 0;
+    virtual void WriteToJsonStream( cJsonWriter& lWriter ) const = 0;
+
+    virtual void AccumulateMemory( sNodeMemoryReport& lReport ) const = 0;
 
     eNodeType GetNodeType() const
     {
@@ -158,40 +169,161 @@ private:
     static std::map< eNodeType, std::string > sNodeTypesToNames;
 };
 
+// Children are held in a small vector, inline while there are no more than kiInlineChildren
 class cDataNodeArray : public cDataNode
 {
 public:
-    cDataNodeArray( eNodeType leNodeType ) : cDataNode( leNodeType ), msNodeId( msNextNodeId++ ) {}
+    static constexpr int kiInlineChildren = 2;
+
+    cDataNodeArray( eNodeType leNodeType ) : cDataNode( leNodeType ), msNodeId( (short)msNextNodeId++ ), miNumChildren( 0 ), miCapacity( kiInlineChildren ) {}
     virtual ~cDataNodeArray();
 
     virtual bool ReadFromBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd ) final;
     virtual bool ReadFromTextStream( char*& lpStreamPtr, const char* lpStreamEnd ) final;
+    virtual bool ReadFromReader( cDataReader& lReader ) final;
 
     virtual bool WriteToBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd ) const final;
     virtual bool WriteToTextStream( char*& lpStreamPtr, const char* lpStreamEnd, int liDepth ) const;
+    virtual void WriteToJsonStream( cJsonWriter& lWriter ) const;
 
-    static int msNextNodeId;
+    virtual void AccumulateMemory( sNodeMemoryReport& lReport ) const;
+
+    int GetNumChildren() const
+    {
+        return (int)miNumChildren;
+    }
+
+    cDataNode* GetChild( int liIndex ) const
+    {
+        return GetChildren()[ liIndex ];
+    }
+
+    // The array takes ownership of the child, and deletes any child it replaces
+    void AddChild( cDataNode* lpChild );
+    void ReplaceChild( int liIndex, cDataNode* lpChild );
+
+    // Ids handed to arrays that aren't read from binary data. Per thread, and reset for each file that's parsed,
+    // so files converted in a batch get the same ids as when converted on their own.
+    static thread_local int msNextNodeId;
 
 private:
-    std::vector< cDataNode* > maChildren;
-    short msNodeId;
+    bool IsOnHeap() const
+    {
+        return miCapacity > kiInlineChildren;
+    }
+
+    cDataNode* const* GetChildren() const
+    {
+        return IsOnHeap() ? mpHeapChildren : maInlineChildren;
+    }
+
+    void Reserve( int liCapacity );
+
+    // Text files can hold more children than the binary format's short count, so the count here is wider
+    short    msNodeId;
+    uint32_t miNumChildren;
+    uint32_t miCapacity;
+    union
+    {
+        cDataNode** mpHeapChildren;
+        cDataNode*  maInlineChildren[ kiInlineChildren ];
+    };
 };
 
+// Strings are held by one of two node types, picked by length when the node is created: short strings inline in the
+// node, longer ones on the heap. The byte after the node type tells them apart.
 class cDataNodeString : public cDataNode
 {
 public:
-    cDataNodeString( eNodeType leNodeType ) : cDataNode( leNodeType ) {}
+    static constexpr size_t kiMaxShortLength = 6;
+
+    // Creates the smallest node that holds lString, which must already be escaped
+    static cDataNodeString* Create( eNodeType leNodeType, std::string_view lString );
+
+    // Creates the smallest node that holds the unescaped form of a string, as stored in binary data
+    static cDataNodeString* CreateFromBinaryString( eNodeType leNodeType, const char* lpString, int liStringLength );
 
     virtual bool ReadFromBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd ) final;
     virtual bool ReadFromTextStream( char*& lpStreamPtr, const char* lpStreamEnd ) final;
+    virtual bool ReadFromReader( cDataReader& lReader ) final;
 
     virtual bool WriteToBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd ) const final;
     virtual bool WriteToTextStream( char*& lpStreamPtr, const char* lpStreamEnd, int liDepth ) const;
+    virtual void WriteToJsonStream( cJsonWriter& lWriter ) const;
+
+    // Quotes are held escaped, as \"
+    std::string_view GetString() const;
+
+    // Sets the string from its unescaped form, as stored in binary data. Fails if it's too long for a short node.
+    bool SetFromBinaryString( const char* lpString, int liStringLength );
+
+    // Turns a string held by a node back into its unescaped form
+    static std::string Unescape( std::string_view lString );
+
+protected:
+    static constexpr uint8_t kiLongMarker = 0xFF;
+
+    cDataNodeString( eNodeType leNodeType, uint8_t liShortLength ) : cDataNode( leNodeType ), miShortLength( liShortLength ) {}
+
+    // Makes room for liLength characters, returning where to write them, or nullptr if they don't fit
+    virtual char* Resize( size_t liLength ) = 0;
+
+    bool Assign( std::string_view lString );
+
+    // Length of a short node's string, or kiLongMarker
+    uint8_t miShortLength;
+};
+
+// Up to kiMaxShortLength characters, with no terminator
+class cDataNodeShortString final : public cDataNodeString
+{
+public:
+    cDataNodeShortString( eNodeType leNodeType ) : cDataNodeString( leNodeType, 0 ) {}
+
+    virtual void AccumulateMemory( sNodeMemoryReport& lReport ) const;
+
+    std::string_view GetString() const
+    {
+        return std::string_view( maString, miShortLength );
+    }
 
 private:
-    std::string mString;
+    virtual char* Resize( size_t liLength );
+
+    char maString[ kiMaxShortLength ];
 };
 
+// Any length, held on the heap with a terminator
+class cDataNodeLongString final : public cDataNodeString
+{
+public:
+    cDataNodeLongString( eNodeType leNodeType ) : cDataNodeString( leNodeType, kiLongMarker ), miLength( 0 ), mpString( nullptr ) {}
+    virtual ~cDataNodeLongString();
+
+    cDataNodeLongString( const cDataNodeLongString& ) = delete;
+    cDataNodeLongString& operator=( const cDataNodeLongString& ) = delete;
+
+    virtual void AccumulateMemory( sNodeMemoryReport& lReport ) const;
+
+    std::string_view GetString() const
+    {
+        return mpString ? std::string_view( mpString, miLength ) : std::string_view();
+    }
+
+private:
+    virtual char* Resize( size_t liLength );
+
+    uint32_t miLength;
+    char*    mpString;
+};
+
+inline std::string_view cDataNodeString::GetString() const
+{
+    return miShortLength == kiLongMarker
+        ? static_cast< const cDataNodeLongString* >( this )->GetString()
+        : static_cast< const cDataNodeShortString* >( this )->GetString();
+}
+
 template <typename T>
 class cDataNodeAtomic : public cDataNode
 {
@@ -208,6 +340,12 @@ public:
     {
         return ::ReadFromTextStream( lpStreamPtr, lpStreamEnd, mValue );
     }
+
+    virtual bool ReadFromReader( cDataReader& lReader ) final
+    {
+        mValue = lReader.GetValue< T >();
+        return true;
+    }
     
     virtual bool WriteToBinaryStream( char*& lpStreamPtr, const char* lpStreamEnd ) const final
     {
@@ -225,22 +363,55 @@ public:
         return WriteJsonlike( lpStreamPtr, lpStreamEnd, liDepth + 1, GetValueAsString( meNodeType, true ), lpValueString, false, true, true );
     }
 
+    virtual void WriteToJsonStream( cJsonWriter& lWriter ) const
+    {
+        // JSON has no NaN or infinity, so those are written as null
+        lWriter.WriteValue( GetValueAsString( meNodeType, true ), std::isfinite( (double)mValue ) ? ValueAsString() : "null", false );
+    }
+
+    virtual void AccumulateMemory( sNodeMemoryReport& lReport ) const
+    {
+        sNodeMemoryReport::sEntry& lEntry = lReport.maEntries[ meNodeType ];
+        ++lEntry.miNumNodes;
+        lEntry.miNodeBytes += sizeof( *this );
+    }
+
+    T GetValue() const
+    {
+        return mValue;
+    }
+
+    void SetValue( T lValue )
+    {
+        mValue = lValue;
+    }
+
 private:
     const char* ValueAsString() const;
 
     T mValue;
 };
 
+template <>
 inline const char* cDataNodeAtomic< int >::ValueAsString() const
 {
-    static char lAsString[ 8 ];
+    static thread_local char lAsString[ 12 ];
     _itoa_s( mValue, lAsString, 10 );
     return lAsString;
 }
 
+template <>
 inline const char* cDataNodeAtomic< float >::ValueAsString() const
 {
-    static char lAsString[ 16 ];
+    static thread_local char lAsString[ 48 ];
     sprintf_s( lAsString, "%.6f", mValue );
     return lAsString;
 }
+
+// These sizes rely on the Itanium C++ ABI packing members into the tail padding of the base class
+#ifndef _MSC_VER
+static_assert( sizeof( void* ) != 8 || sizeof( cDataNodeAtomic< int > ) == 16, "Scalar nodes should be 16 bytes" );
+static_assert( sizeof( void* ) != 8 || sizeof( cDataNodeShortString ) == 16, "Short string nodes should be 16 bytes" );
+static_assert( sizeof( void* ) != 8 || sizeof( cDataNodeLongString ) == 24, "Long string nodes should be 24 bytes" );
+static_assert( sizeof( void* ) != 8 || sizeof( cDataNodeArray ) == 40, "Array nodes should be 40 bytes" );
+#endif
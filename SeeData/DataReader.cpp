@@ -0,0 +1,136 @@
+#include "DataReader.h"
+#include <cstring>
+
+cDataReader::cDataReader( const char* lpData, size_t liDataSize, eNodeType leRootType )
+    : mpData( lpData )
+    , mpDataPtr( lpData )
+    , mpDataEnd( lpData + liDataSize )
+    , mpValue( lpData )
+    , mpError( nullptr )
+    , meNodeType( leRootType )
+    , miValueSize( 0 )
+    , miValue( 0 )
+    , msNodeId( 0 )
+    , msNumChildren( 0 )
+    , miDepth( 0 )
+    , mbStarted( false )
+{
+}
+
+eReadEvent cDataReader::Next()
+{
+    if( mpError )
+    {
+        return EReadEvent_Error;
+    }
+
+    if( !mbStarted )
+    {
+        mbStarted = true;
+        return BeginArray();
+    }
+
+    if( miDepth == 0 )
+    {
+        return EReadEvent_EndOfStream;
+    }
+
+    if( maRemainingChildren[ miDepth - 1 ] == 0 )
+    {
+        --miDepth;
+        meNodeType = (eNodeType)maArrayTypes[ miDepth ];
+        return EReadEvent_EndArray;
+    }
+    --maRemainingChildren[ miDepth - 1 ];
+
+    int liNodeType = 0;
+    if( !Read( liNodeType ) )
+    {
+        return Fail( "Unexpected end of data reading node type" );
+    }
+    if( liNodeType < 0 || liNodeType >= ENodeType_Invalid )
+    {
+        return Fail( "Unknown node type" );
+    }
+    meNodeType = (eNodeType)liNodeType;
+
+    switch( meNodeType )
+    {
+        case ENodeType_Tree1:
+        case ENodeType_Tree2:
+            return BeginArray();
+
+        case ENodeType_Integer0:
+        case ENodeType_Integer6:
+        case ENodeType_Integer8:
+        case ENodeType_Integer9:
+        case ENodeType_Float:
+            mpValue = mpDataPtr;
+            miValueSize = sizeof( int );
+            if( !Read( miValue ) )
+            {
+                return Fail( "Unexpected end of data reading value" );
+            }
+            return EReadEvent_Value;
+
+        case ENodeType_Text:
+        case ENodeType_String:
+        case ENodeType_Id:
+        case ENodeType_IncludeFile:
+        case ENodeType_Define:
+            if( !Read( miValueSize ) || miValueSize < 0 || miValueSize > mpDataEnd - mpDataPtr )
+            {
+                return Fail( "Unexpected end of data reading string" );
+            }
+            mpValue = mpDataPtr;
+            mpDataPtr += miValueSize;
+            return EReadEvent_Value;
+
+        default:
+            return Fail( "Unknown node type" );
+    }
+}
+
+eReadEvent cDataReader::BeginArray()
+{
+    if( miDepth == kiMaxDepth )
+    {
+        return Fail( "Arrays nested too deeply" );
+    }
+
+    int liArrayMarker = 0;
+    if( !Read( liArrayMarker ) || !Read( msNumChildren ) || !Read( msNodeId ) )
+    {
+        return Fail( "Unexpected end of data reading array" );
+    }
+
+    if( liArrayMarker != 1 || msNumChildren < 0 )
+    {
+        return Fail( "Invalid array header" );
+    }
+
+    maArrayTypes[ miDepth ] = (unsigned char)meNodeType;
+    maRemainingChildren[ miDepth ] = msNumChildren;
+    ++miDepth;
+
+    return EReadEvent_BeginArray;
+}
+
+eReadEvent cDataReader::Fail( const char* lpError )
+{
+    mpError = lpError;
+    return EReadEvent_Error;
+}
+
+template < typename T >
+bool cDataReader::Read( T& lValue )
+{
+    if( mpDataEnd - mpDataPtr < (ptrdiff_t)sizeof( T ) )
+    {
+        return false;
+    }
+
+    memcpy( &lValue, mpDataPtr, sizeof( T ) );
+    mpDataPtr += sizeof( T );
+    return true;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include "NodeType.h"
+
+enum eReadEvent {
+    EReadEvent_BeginArray,
+    EReadEvent_EndArray,
+    EReadEvent_Value,
+    EReadEvent_EndOfStream,
+    EReadEvent_Error,
+};
+
+// Pull parser over binary data held in a caller supplied buffer. It never allocates, strings are returned as views
+// into the buffer and only a fixed depth stack of child counts is kept while walking the arrays.
+//
+//   cDataReader lReader( lpData, liDataSize );
+//   for( eReadEvent leEvent = lReader.Next(); leEvent < EReadEvent_EndOfStream; leEvent = lReader.Next() ) ...
+class cDataReader
+{
+public:
+    static constexpr int kiMaxDepth = 64;
+
+    // lpData points at the body of an array node of type leRootType, as found after the header byte of a binary file
+    cDataReader( const char* lpData, size_t liDataSize, eNodeType leRootType = ENodeType_Tree1 );
+
+    // Checks for the header byte which starts every binary file
+    static bool IsBinaryData( const char* lpData, size_t liDataSize )
+    {
+        return liDataSize > 0 && *lpData == 1;
+    }
+
+    eReadEvent Next();
+
+    // Valid after every event other than EReadEvent_EndOfStream and EReadEvent_Error
+    eNodeType GetNodeType() const
+    {
+        return meNodeType;
+    }
+
+    // Valid after EReadEvent_BeginArray
+    short GetNodeId() const
+    {
+        return msNodeId;
+    }
+
+    int GetNumChildren() const
+    {
+        return msNumChildren;
+    }
+
+    // Valid after EReadEvent_Value, depending on the node type
+    int GetInt() const
+    {
+        return miValue;
+    }
+
+    float GetFloat() const
+    {
+        return mfValue;
+    }
+
+    std::string_view GetString() const
+    {
+        return std::string_view( mpValue, miValueSize );
+    }
+
+    template < typename T >
+    T GetValue() const;
+
+    // Offset in the buffer of the current value's payload, and the size of that payload in bytes
+    size_t GetValueOffset() const
+    {
+        return mpValue - mpData;
+    }
+
+    int GetValueSize() const
+    {
+        return miValueSize;
+    }
+
+    // Number of arrays currently open, including the root
+    int GetDepth() const
+    {
+        return miDepth;
+    }
+
+    // Number of bytes of the buffer that have been consumed so far
+    size_t GetOffset() const
+    {
+        return mpDataPtr - mpData;
+    }
+
+    const char* GetError() const
+    {
+        return mpError;
+    }
+
+private:
+    eReadEvent BeginArray();
+    eReadEvent Fail( const char* lpError );
+
+    template < typename T >
+    bool Read( T& lValue );
+
+    const char*   mpData;
+    const char*   mpDataPtr;
+    const char*   mpDataEnd;
+    const char*   mpValue;
+    const char*   mpError;
+
+    eNodeType     meNodeType;
+    int           miValueSize;
+    union
+    {
+        int       miValue;
+        float     mfValue;
+    };
+    short         msNodeId;
+    short         msNumChildren;
+
+    int           miDepth;
+    bool          mbStarted;
+    short         maRemainingChildren[ kiMaxDepth ];
+    unsigned char maArrayTypes[ kiMaxDepth ];
+};
+
+template <>
+inline int cDataReader::GetValue< int >() const
+{
+    return miValue;
+}
+
+template <>
+inline float cDataReader::GetValue< float >() const
+{
+    return mfValue;
+}
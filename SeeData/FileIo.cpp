@@ -0,0 +1,441 @@
+#include "FileIo.h"
+#include "BoundedQueue.h"
+#include "Platform.h"
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#if defined( SEEDATA_USE_IO_URING ) && defined( __linux__ )
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Fallback backend, each worker thread performs blocking reads and writes through the C runtime
+    class cThreadPoolFileIo : public cFileIo
+    {
+    public:
+        cThreadPoolFileIo( int liQueueDepth )
+            : maPending( liQueueDepth )
+            , maCompleted( liQueueDepth )
+        {
+            unsigned int liNumThreads = liQueueDepth < 16 ? liQueueDepth : 16;
+            for( unsigned int ii = 0; ii < liNumThreads; ++ii )
+            {
+                maThreads.emplace_back( [ this ] { WorkerThread(); } );
+            }
+        }
+
+        virtual ~cThreadPoolFileIo()
+        {
+            maPending.Close();
+            for( std::thread& lThread : maThreads )
+            {
+                lThread.join();
+            }
+        }
+
+        virtual const char* GetName() const
+        {
+            return "thread pool";
+        }
+
+        virtual void Submit( sFileRequest* lpRequest )
+        {
+            maPending.Push( lpRequest );
+        }
+
+        virtual sFileRequest* WaitForCompletion()
+        {
+            sFileRequest* lpRequest = nullptr;
+            maCompleted.Pop( lpRequest );
+            return lpRequest;
+        }
+
+    private:
+        void WorkerThread()
+        {
+            sFileRequest* lpRequest = nullptr;
+            while( maPending.Pop( lpRequest ) )
+            {
+                lpRequest->mbSucceeded = lpRequest->mbWrite ? Write( *lpRequest ) : Read( *lpRequest );
+                maCompleted.Push( lpRequest );
+            }
+        }
+
+        static bool Read( sFileRequest& lRequest )
+        {
+            FILE* lpFile = nullptr;
+            fopen_s( &lpFile, lRequest.mFilename.c_str(), "rb" );
+            if( !lpFile )
+            {
+                lRequest.mError = "Error reading file \"" + lRequest.mFilename + "\"";
+                return false;
+            }
+
+            fseek( lpFile, 0, SEEK_END );
+            long liFileSize = ftell( lpFile );
+            fseek( lpFile, 0, SEEK_SET );
+
+            lRequest.mData.resize( liFileSize > 0 ? liFileSize : 0 );
+            bool lbRead = lRequest.mData.empty() || fread( lRequest.mData.data(), lRequest.mData.size(), 1, lpFile ) == 1;
+            fclose( lpFile );
+
+            if( !lbRead )
+            {
+                lRequest.mError = "Error reading file \"" + lRequest.mFilename + "\"";
+            }
+            return lbRead;
+        }
+
+        static bool Write( sFileRequest& lRequest )
+        {
+            FILE* lpFile = nullptr;
+            fopen_s( &lpFile, lRequest.mFilename.c_str(), "wb" );
+            if( !lpFile )
+            {
+                lRequest.mError = "Error opening file \"" + lRequest.mFilename + "\" for writing";
+                return false;
+            }
+
+            bool lbWritten = lRequest.mData.empty() || fwrite( lRequest.mData.data(), lRequest.mData.size(), 1, lpFile ) == 1;
+            fclose( lpFile );
+
+            if( !lbWritten )
+            {
+                lRequest.mError = "Error writing file \"" + lRequest.mFilename + "\"";
+            }
+            return lbWritten;
+        }
+
+        cBoundedQueue< sFileRequest* > maPending;
+        cBoundedQueue< sFileRequest* > maCompleted;
+        std::vector< std::thread >     maThreads;
+    };
+
+#if defined( SEEDATA_USE_IO_URING ) && defined( __linux__ )
+
+    // Talks to io_uring through the raw system calls, so there's no dependency on liburing. Opening and sizing
+    // files is still synchronous, only the reads and writes themselves go through the ring.
+    class cUringFileIo : public cFileIo
+    {
+    public:
+        ~cUringFileIo()
+        {
+            if( mpSqes )
+            {
+                munmap( mpSqes, miSqesSize );
+            }
+            if( mpCqRing && mpCqRing != mpSqRing )
+            {
+                munmap( mpCqRing, miCqRingSize );
+            }
+            if( mpSqRing )
+            {
+                munmap( mpSqRing, miSqRingSize );
+            }
+            if( miRingFile >= 0 )
+            {
+                close( miRingFile );
+            }
+        }
+
+        static std::unique_ptr< cFileIo > Create( int liQueueDepth )
+        {
+            std::unique_ptr< cUringFileIo > lpFileIo( new cUringFileIo() );
+            if( !lpFileIo->Initialise( liQueueDepth ) )
+            {
+                return nullptr;
+            }
+            return std::move( lpFileIo );
+        }
+
+        virtual const char* GetName() const
+        {
+            return "io_uring";
+        }
+
+        virtual void Submit( sFileRequest* lpRequest )
+        {
+            lpRequest->miOffset = 0;
+            lpRequest->miFile = lpRequest->mbWrite
+                ? open( lpRequest->mFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 )
+                : open( lpRequest->mFilename.c_str(), O_RDONLY );
+
+            if( lpRequest->miFile < 0 )
+            {
+                Complete( lpRequest, false );
+                return;
+            }
+
+            if( !lpRequest->mbWrite )
+            {
+                struct stat lFileStats;
+                if( fstat( lpRequest->miFile, &lFileStats ) != 0 )
+                {
+                    Complete( lpRequest, false );
+                    return;
+                }
+                lpRequest->mData.resize( lFileStats.st_size );
+            }
+
+            if( lpRequest->mData.empty() )
+            {
+                Complete( lpRequest, true );
+                return;
+            }
+
+            SubmitTransfer( lpRequest );
+        }
+
+        virtual sFileRequest* WaitForCompletion()
+        {
+            while( maReady.empty() )
+            {
+                unsigned int liHead = *mpCqHead;
+                if( liHead == __atomic_load_n( mpCqTail, __ATOMIC_ACQUIRE ) )
+                {
+                    if( Enter( 0, 1, IORING_ENTER_GETEVENTS ) < 0 && errno != EINTR )
+                    {
+                        return nullptr;
+                    }
+                    continue;
+                }
+
+                const io_uring_cqe& lCompletion = mpCqes[ liHead & *mpCqMask ];
+                int liResult = lCompletion.res;
+                sFileRequest* lpRequest = maSlots[ lCompletion.user_data ].mpRequest;
+                maFreeSlots.push_back( (unsigned int)lCompletion.user_data );
+                __atomic_store_n( mpCqHead, liHead + 1, __ATOMIC_RELEASE );
+
+                if( liResult <= 0 )
+                {
+                    errno = liResult < 0 ? -liResult : EIO;
+                    Complete( lpRequest, false );
+                    continue;
+                }
+
+                // Short transfers are resubmitted for whatever is left
+                lpRequest->miOffset += liResult;
+                if( lpRequest->miOffset < lpRequest->mData.size() )
+                {
+                    SubmitTransfer( lpRequest );
+                }
+                else
+                {
+                    Complete( lpRequest, true );
+                }
+            }
+
+            sFileRequest* lpRequest = maReady.back();
+            maReady.pop_back();
+            return lpRequest;
+        }
+
+    private:
+        struct sSlot
+        {
+            sFileRequest* mpRequest;
+            iovec         mBuffer;
+        };
+
+        cUringFileIo() {}
+
+        bool Initialise( int liQueueDepth )
+        {
+            io_uring_params lParams;
+            memset( &lParams, 0, sizeof( lParams ) );
+
+            miRingFile = (int)syscall( __NR_io_uring_setup, liQueueDepth, &lParams );
+            if( miRingFile < 0 )
+            {
+                return false;
+            }
+
+            miSqRingSize = lParams.sq_off.array + lParams.sq_entries * sizeof( unsigned int );
+            miCqRingSize = lParams.cq_off.cqes + lParams.cq_entries * sizeof( io_uring_cqe );
+            if( lParams.features & IORING_FEAT_SINGLE_MMAP )
+            {
+                miSqRingSize = miCqRingSize = miSqRingSize > miCqRingSize ? miSqRingSize : miCqRingSize;
+            }
+
+            mpSqRing = MapRing( miSqRingSize, IORING_OFF_SQ_RING );
+            if( !mpSqRing )
+            {
+                return false;
+            }
+
+            mpCqRing = ( lParams.features & IORING_FEAT_SINGLE_MMAP ) ? mpSqRing : MapRing( miCqRingSize, IORING_OFF_CQ_RING );
+            if( !mpCqRing )
+            {
+                return false;
+            }
+
+            miSqesSize = lParams.sq_entries * sizeof( io_uring_sqe );
+            mpSqes = (io_uring_sqe*)MapRing( miSqesSize, IORING_OFF_SQES );
+            if( !mpSqes )
+            {
+                return false;
+            }
+
+            char* lpSqRing = (char*)mpSqRing;
+            mpSqTail  = (unsigned int*)( lpSqRing + lParams.sq_off.tail );
+            mpSqMask  = (unsigned int*)( lpSqRing + lParams.sq_off.ring_mask );
+            mpSqArray = (unsigned int*)( lpSqRing + lParams.sq_off.array );
+
+            char* lpCqRing = (char*)mpCqRing;
+            mpCqHead = (unsigned int*)( lpCqRing + lParams.cq_off.head );
+            mpCqTail = (unsigned int*)( lpCqRing + lParams.cq_off.tail );
+            mpCqMask = (unsigned int*)( lpCqRing + lParams.cq_off.ring_mask );
+            mpCqes   = (io_uring_cqe*)( lpCqRing + lParams.cq_off.cqes );
+
+            maSlots.resize( lParams.sq_entries );
+            for( unsigned int ii = 0; ii < lParams.sq_entries; ++ii )
+            {
+                maFreeSlots.push_back( lParams.sq_entries - 1 - ii );
+            }
+
+            return true;
+        }
+
+        void* MapRing( size_t liSize, long long liOffset )
+        {
+            void* lpRing = mmap( nullptr, liSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, miRingFile, liOffset );
+            return lpRing == MAP_FAILED ? nullptr : lpRing;
+        }
+
+        int Enter( unsigned int liToSubmit, unsigned int liMinComplete, unsigned int liFlags )
+        {
+            return (int)syscall( __NR_io_uring_enter, miRingFile, liToSubmit, liMinComplete, liFlags, nullptr, 0 );
+        }
+
+        void SubmitTransfer( sFileRequest* lpRequest )
+        {
+            // The caller never has more requests in flight than the ring has entries
+            unsigned int liSlot = maFreeSlots.back();
+            maFreeSlots.pop_back();
+
+            sSlot& lSlot = maSlots[ liSlot ];
+            lSlot.mpRequest = lpRequest;
+            lSlot.mBuffer.iov_base = lpRequest->mData.data() + lpRequest->miOffset;
+            lSlot.mBuffer.iov_len = lpRequest->mData.size() - lpRequest->miOffset;
+
+            unsigned int liTail = *mpSqTail;
+            unsigned int liIndex = liTail & *mpSqMask;
+
+            io_uring_sqe& lEntry = mpSqes[ liIndex ];
+            memset( &lEntry, 0, sizeof( lEntry ) );
+            lEntry.opcode = lpRequest->mbWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+            lEntry.fd = lpRequest->miFile;
+            lEntry.addr = (unsigned long long)&lSlot.mBuffer;
+            lEntry.len = 1;
+            lEntry.off = lpRequest->miOffset;
+            lEntry.user_data = liSlot;
+
+            mpSqArray[ liIndex ] = liIndex;
+            __atomic_store_n( mpSqTail, liTail + 1, __ATOMIC_RELEASE );
+
+            int liSubmitted = 0;
+            do
+            {
+                liSubmitted = Enter( 1, 0, 0 );
+            } while( liSubmitted < 0 && errno == EINTR );
+
+            // Without SQPOLL the kernel only takes entries inside io_uring_enter, so one it refused can be withdrawn
+            // and the transfer done here instead of being lost
+            if( liSubmitted != 1 )
+            {
+                __atomic_store_n( mpSqTail, liTail, __ATOMIC_RELEASE );
+                maFreeSlots.push_back( liSlot );
+                TransferSynchronously( lpRequest );
+            }
+        }
+
+        void TransferSynchronously( sFileRequest* lpRequest )
+        {
+            while( lpRequest->miOffset < lpRequest->mData.size() )
+            {
+                char* lpBuffer = lpRequest->mData.data() + lpRequest->miOffset;
+                size_t liSize = lpRequest->mData.size() - lpRequest->miOffset;
+                ssize_t liResult = lpRequest->mbWrite
+                    ? pwrite( lpRequest->miFile, lpBuffer, liSize, lpRequest->miOffset )
+                    : pread( lpRequest->miFile, lpBuffer, liSize, lpRequest->miOffset );
+
+                if( liResult < 0 && errno == EINTR )
+                {
+                    continue;
+                }
+                if( liResult <= 0 )
+                {
+                    if( liResult == 0 )
+                    {
+                        errno = EIO;
+                    }
+                    Complete( lpRequest, false );
+                    return;
+                }
+                lpRequest->miOffset += liResult;
+            }
+
+            Complete( lpRequest, true );
+        }
+
+        void Complete( sFileRequest* lpRequest, bool lbSucceeded )
+        {
+            if( !lbSucceeded )
+            {
+                lpRequest->mError = std::string( lpRequest->mbWrite ? "Error writing file \"" : "Error reading file \"" ) + lpRequest->mFilename + "\" (" + strerror( errno ) + ")";
+            }
+
+            if( lpRequest->miFile >= 0 )
+            {
+                close( lpRequest->miFile );
+                lpRequest->miFile = -1;
+            }
+
+            lpRequest->mbSucceeded = lbSucceeded;
+            maReady.push_back( lpRequest );
+        }
+
+        int                           miRingFile = -1;
+        void*                         mpSqRing = nullptr;
+        void*                         mpCqRing = nullptr;
+        io_uring_sqe*                 mpSqes = nullptr;
+        size_t                        miSqRingSize = 0;
+        size_t                        miCqRingSize = 0;
+        size_t                        miSqesSize = 0;
+
+        unsigned int*                 mpSqTail = nullptr;
+        unsigned int*                 mpSqMask = nullptr;
+        unsigned int*                 mpSqArray = nullptr;
+        unsigned int*                 mpCqHead = nullptr;
+        unsigned int*                 mpCqTail = nullptr;
+        unsigned int*                 mpCqMask = nullptr;
+        io_uring_cqe*                 mpCqes = nullptr;
+
+        std::vector< sSlot >          maSlots;
+        std::vector< unsigned int >   maFreeSlots;
+        std::vector< sFileRequest* >  maReady;
+    };
+
+#endif
+}
+
+std::unique_ptr< cFileIo > cFileIo::Create( int liQueueDepth )
+{
+#if defined( SEEDATA_USE_IO_URING ) && defined( __linux__ )
+    std::unique_ptr< cFileIo > lpFileIo = cUringFileIo::Create( liQueueDepth );
+    if( lpFileIo )
+    {
+        return lpFileIo;
+    }
+#endif
+
+    return std::unique_ptr< cFileIo >( new cThreadPoolFileIo( liQueueDepth ) );
+}
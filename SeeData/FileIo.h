@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// A whole file read or write, handed to cFileIo and returned by it once complete
+struct sFileRequest
+{
+    std::string         mFilename;
+    std::vector< char > mData;
+    std::string         mError;
+    bool                mbWrite = false;
+    bool                mbSucceeded = false;
+
+    // Backend specific state while the request is in flight
+    int                 miFile = -1;
+    size_t              miOffset = 0;
+};
+
+// Asynchronous whole file I/O. Requests are submitted and later collected in completion order, so the caller can
+// keep several files in flight at once. An instance must only be driven from a single thread.
+class cFileIo
+{
+public:
+    // Uses io_uring where it's compiled in and the kernel allows it, otherwise a pool of blocking I/O threads
+    static std::unique_ptr< cFileIo > Create( int liQueueDepth );
+
+    virtual ~cFileIo() {}
+
+    virtual const char* GetName() const = 0;
+
+    // Reads the whole of lpRequest->mFilename into mData, or writes mData out to it
+    virtual void Submit( sFileRequest* lpRequest ) = 0;
+
+    // Blocks until one of the submitted requests has completed and returns it
+    virtual sFileRequest* WaitForCompletion() = 0;
+};
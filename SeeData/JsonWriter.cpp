@@ -0,0 +1,223 @@
+#include "JsonWriter.h"
+#include <cstring>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define SEEDATA_JSON_SSE2 1
+#endif
+
+namespace
+{
+    bool NeedsEscaping( unsigned char lCharacter )
+    {
+        return lCharacter < 0x20 || lCharacter == '\"' || lCharacter == '\\';
+    }
+
+    // Returns the length of the run at the start of lpString that can be copied out unescaped
+    size_t FindEscapeCandidate( const char* lpString, size_t liLength )
+    {
+        size_t liIndex = 0;
+
+#if SEEDATA_JSON_SSE2
+        const __m128i lQuote     = _mm_set1_epi8( '\"' );
+        const __m128i lBackslash = _mm_set1_epi8( '\\' );
+        const __m128i lControl   = _mm_set1_epi8( 0x1F );
+
+        for( ; liIndex + 16 <= liLength; liIndex += 16 )
+        {
+            __m128i lChunk = _mm_loadu_si128( (const __m128i*)( lpString + liIndex ) );
+
+            // max( x, 0x1F ) == 0x1F only for the unsigned bytes below 0x20
+            __m128i lMatches = _mm_or_si128(
+                _mm_or_si128( _mm_cmpeq_epi8( lChunk, lQuote ), _mm_cmpeq_epi8( lChunk, lBackslash ) ),
+                _mm_cmpeq_epi8( _mm_max_epu8( lChunk, lControl ), lControl ) );
+
+            int liMask = _mm_movemask_epi8( lMatches );
+            if( liMask != 0 )
+            {
+                unsigned int liBit = 0;
+                while( ( liMask & ( 1 << liBit ) ) == 0 )
+                {
+                    ++liBit;
+                }
+                return liIndex + liBit;
+            }
+        }
+#endif
+
+        while( liIndex < liLength && !NeedsEscaping( (unsigned char)lpString[ liIndex ] ) )
+        {
+            ++liIndex;
+        }
+        return liIndex;
+    }
+}
+
+cJsonWriter::cJsonWriter( FILE* lpOutputFile, bool lbNewlineDelimited )
+    : mpOutputFile( lpOutputFile )
+    , mpChunk( new char[ kiChunkSize ] )
+    , mbNewlineDelimited( lbNewlineDelimited )
+    , mbFailed( false )
+{
+    mpChunkPtr = mpChunk;
+}
+
+cJsonWriter::~cJsonWriter()
+{
+    Flush();
+    delete[] mpChunk;
+}
+
+void cJsonWriter::BeginArray( const char* lpTypeName )
+{
+    // In NDJSON mode the root array only exists to hold the records, so it isn't written
+    if( !mbNewlineDelimited || !maNeedsComma.empty() )
+    {
+        BeginNode( lpTypeName );
+        Write( '[' );
+    }
+    maNeedsComma.push_back( false );
+}
+
+void cJsonWriter::EndArray()
+{
+    maNeedsComma.pop_back();
+    if( !mbNewlineDelimited || !maNeedsComma.empty() )
+    {
+        Write( ']' );
+        EndNode();
+    }
+}
+
+void cJsonWriter::WriteValue( const char* lpTypeName, const char* lpValue, bool lbQuoted )
+{
+    BeginNode( lpTypeName );
+    if( lbQuoted )
+    {
+        Write( '\"' );
+        WriteEscaped( lpValue );
+        Write( '\"' );
+    }
+    else
+    {
+        Write( lpValue, strlen( lpValue ) );
+    }
+    EndNode();
+}
+
+bool cJsonWriter::Flush()
+{
+    size_t liSize = mpChunkPtr - mpChunk;
+    if( liSize && fwrite( mpChunk, liSize, 1, mpOutputFile ) != 1 )
+    {
+        mbFailed = true;
+    }
+    mpChunkPtr = mpChunk;
+
+    return !mbFailed;
+}
+
+void cJsonWriter::BeginNode( const char* lpTypeName )
+{
+    bool lbIsRecord = mbNewlineDelimited && maNeedsComma.size() == 1;
+    if( !maNeedsComma.empty() )
+    {
+        if( maNeedsComma.back() && !lbIsRecord )
+        {
+            Write( ',' );
+        }
+        maNeedsComma.back() = true;
+    }
+
+    Write( "{\"", 2 );
+    WriteEscaped( lpTypeName );
+    Write( "\":", 2 );
+}
+
+void cJsonWriter::EndNode()
+{
+    Write( '}' );
+    if( maNeedsComma.size() <= ( mbNewlineDelimited ? 1u : 0u ) )
+    {
+        Write( '\n' );
+    }
+}
+
+void cJsonWriter::Write( const char* lpData, size_t liSize )
+{
+    while( liSize > 0 )
+    {
+        size_t liSpace = kiChunkSize - ( mpChunkPtr - mpChunk );
+        if( liSpace == 0 )
+        {
+            Flush();
+            continue;
+        }
+
+        size_t liCopySize = liSize < liSpace ? liSize : liSpace;
+        memcpy( mpChunkPtr, lpData, liCopySize );
+        mpChunkPtr += liCopySize;
+        lpData += liCopySize;
+        liSize -= liCopySize;
+    }
+}
+
+void cJsonWriter::Write( char lCharacter )
+{
+    if( mpChunkPtr == mpChunk + kiChunkSize )
+    {
+        Flush();
+    }
+    *mpChunkPtr++ = lCharacter;
+}
+
+void cJsonWriter::WriteEscaped( const char* lpString )
+{
+    static const char kaHexDigits[] = "0123456789abcdef";
+
+    size_t liLength = strlen( lpString );
+    while( liLength > 0 )
+    {
+        size_t liRunLength = FindEscapeCandidate( lpString, liLength );
+        Write( lpString, liRunLength );
+        lpString += liRunLength;
+        liLength -= liRunLength;
+
+        if( liLength == 0 )
+        {
+            break;
+        }
+
+        unsigned char lCharacter = (unsigned char)*lpString++;
+        --liLength;
+
+        switch( lCharacter )
+        {
+            case '\\':
+                // Quotes are held as \" in the node strings, so that pair is already a valid escape
+                if( liLength > 0 && *lpString == '\"' )
+                {
+                    ++lpString;
+                    --liLength;
+                    Write( "\\\"", 2 );
+                }
+                else
+                {
+                    Write( "\\\\", 2 );
+                }
+                break;
+
+            case '\"': Write( "\\\"", 2 ); break;
+            case '\n': Write( "\\n", 2 );  break;
+            case '\r': Write( "\\r", 2 );  break;
+            case '\t': Write( "\\t", 2 );  break;
+
+            default:
+            {
+                char laUnicodeEscape[ 6 ] = { '\\', 'u', '0', '0', kaHexDigits[ lCharacter >> 4 ], kaHexDigits[ lCharacter & 0xF ] };
+                Write( laUnicodeEscape, sizeof( laUnicodeEscape ) );
+                break;
+            }
+        }
+    }
+}
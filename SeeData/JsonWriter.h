@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// Streams nodes out as strict JSON ( or NDJSON, one record per top-level node ) through a fixed size chunk,
+// which is flushed to the output file whenever it fills up
+class cJsonWriter
+{
+public:
+    static constexpr int kiChunkSize = 256 * 1024;
+
+    cJsonWriter( FILE* lpOutputFile, bool lbNewlineDelimited );
+    ~cJsonWriter();
+
+    // Every node is written as a single member object, { "<type name>" : <value> }
+    void BeginArray( const char* lpTypeName );
+    void EndArray();
+    void WriteValue( const char* lpTypeName, const char* lpValue, bool lbQuoted );
+
+    bool Flush();
+
+    bool HasFailed() const
+    {
+        return mbFailed;
+    }
+
+private:
+    void BeginNode( const char* lpTypeName );
+    void EndNode();
+
+    void Write( const char* lpData, size_t liSize );
+    void Write( char lCharacter );
+    void WriteEscaped( const char* lpString );
+
+    FILE*               mpOutputFile;
+    char*               mpChunk;
+    char*               mpChunkPtr;
+    std::vector< bool > maNeedsComma;
+    bool                mbNewlineDelimited;
+    bool                mbFailed;
+};
@@ -0,0 +1,508 @@
+#include "LookupTable.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unordered_set>
+#include "BinaryUtil.h"
+#include "DataFile.h"
+#include "DataReader.h"
+#include "Platform.h"
+
+namespace
+{
+    const char kaMagic[ 4 ] = { 'S', 'D', 'T', '1' };
+
+    // Keys in the table average this many per bucket
+    constexpr uint32_t kiKeysPerBucket = 4;
+
+    // Gives up on a bucket after this many seeds, which only happens with keys whose hashes collide completely
+    constexpr uint32_t kiMaxSeed = 1u << 24;
+
+    constexpr int kiBenchmarkRounds = 20;
+
+    struct sPair
+    {
+        std::string_view mKey;
+        std::string_view mValue;
+    };
+
+    bool IsPairArray( const cDataNode* lpNode )
+    {
+        if( !IsArrayType( lpNode->GetNodeType() ) )
+        {
+            return false;
+        }
+
+        const cDataNodeArray* lpArray = static_cast< const cDataNodeArray* >( lpNode );
+        return lpArray->GetNumChildren() == 2 &&
+               IsKeyType( lpArray->GetChild( 0 )->GetNodeType() ) &&
+               IsKeyType( lpArray->GetChild( 1 )->GetNodeType() );
+    }
+
+    std::string_view GetPairString( const cDataNode* lpPair, int liIndex )
+    {
+        return static_cast< const cDataNodeString* >( static_cast< const cDataNodeArray* >( lpPair )->GetChild( liIndex ) )->GetString();
+    }
+
+    void CollectKeys( const cDataNodeArray* lpArray, std::vector< std::string_view >& laKeys )
+    {
+        for( int ii = 0; ii < lpArray->GetNumChildren(); ++ii )
+        {
+            const cDataNode* lpChild = lpArray->GetChild( ii );
+            if( IsPairArray( lpChild ) )
+            {
+                laKeys.push_back( GetPairString( lpChild, 0 ) );
+            }
+            else if( IsArrayType( lpChild->GetNodeType() ) )
+            {
+                CollectKeys( static_cast< const cDataNodeArray* >( lpChild ), laKeys );
+            }
+        }
+    }
+
+    // The lookup the table replaces, walking the tree in document order for the first pair with the key
+    bool FindInTree( const cDataNodeArray* lpArray, std::string_view lKey, std::string_view& lValue )
+    {
+        for( int ii = 0; ii < lpArray->GetNumChildren(); ++ii )
+        {
+            const cDataNode* lpChild = lpArray->GetChild( ii );
+            if( IsPairArray( lpChild ) )
+            {
+                if( GetPairString( lpChild, 0 ) == lKey )
+                {
+                    lValue = GetPairString( lpChild, 1 );
+                    return true;
+                }
+            }
+            else if( IsArrayType( lpChild->GetNodeType() ) &&
+                     FindInTree( static_cast< const cDataNodeArray* >( lpChild ), lKey, lValue ) )
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool LoadAsBinary( cDtaFile& lDataFile, std::vector< char >& lBinary, std::string& lError )
+    {
+        if( lDataFile.GetError() || !lDataFile.ConvertToBinary( lBinary ) )
+        {
+            lError = lDataFile.GetError();
+            return false;
+        }
+        return true;
+    }
+}
+
+bool cLookupTable::Open( const char* lpFilename )
+{
+    if( !mFile.Open( lpFilename, false ) )
+    {
+        return Fail( "Error mapping table file" );
+    }
+    return Attach( mFile.GetData(), mFile.GetSize() );
+}
+
+bool cLookupTable::Attach( const char* lpData, size_t liDataSize )
+{
+    mpError = nullptr;
+    miNumEntries = 0;
+
+    if( liDataSize < kiHeaderSize || memcmp( lpData, kaMagic, sizeof( kaMagic ) ) != 0 )
+    {
+        return Fail( "Not a lookup table" );
+    }
+    if( (uintptr_t)lpData % alignof( uint32_t ) != 0 )
+    {
+        return Fail( "Lookup table data isn't aligned" );
+    }
+
+    uint32_t liNumEntries;
+    uint32_t liNumBuckets;
+    uint32_t liStringsSize;
+    memcpy( &liNumEntries, lpData + 4, sizeof( uint32_t ) );
+    memcpy( &liNumBuckets, lpData + 8, sizeof( uint32_t ) );
+    memcpy( &liStringsSize, lpData + 12, sizeof( uint32_t ) );
+
+    uint64_t liExpectedSize = kiHeaderSize + (uint64_t)liNumBuckets * sizeof( uint32_t ) + (uint64_t)liNumEntries * sizeof( sSlot ) + liStringsSize;
+    if( liExpectedSize != liDataSize || ( liNumEntries && !liNumBuckets ) )
+    {
+        return Fail( "Lookup table is truncated or corrupt" );
+    }
+
+    mpSeeds = (const uint32_t*)( lpData + kiHeaderSize );
+    mpSlots = (const sSlot*)( mpSeeds + liNumBuckets );
+    mpStrings = (const char*)( mpSlots + liNumEntries );
+    miNumBuckets = liNumBuckets;
+    miNumEntries = liNumEntries;
+    miStringsSize = liStringsSize;
+    return true;
+}
+
+bool cLookupTable::Find( std::string_view lKey, std::string_view& lValue ) const
+{
+    if( !miNumEntries )
+    {
+        return false;
+    }
+
+    uint64_t liHash = HashKey( lKey );
+    uint32_t liSeed = mpSeeds[ GetSlot( liHash, 0, miNumBuckets ) ];
+    const sSlot& lSlot = mpSlots[ GetSlot( liHash, liSeed, miNumEntries ) ];
+
+    // Every key hashes to some slot, so the key stored there has to be checked. Offsets are checked here rather
+    // than when the table is opened, so opening a mapped table doesn't have to touch all of it.
+    if( lSlot.miKeyLength != lKey.length() ||
+        (uint64_t)lSlot.miKeyOffset + lSlot.miKeyLength > miStringsSize ||
+        (uint64_t)lSlot.miValueOffset + lSlot.miValueLength > miStringsSize ||
+        memcmp( mpStrings + lSlot.miKeyOffset, lKey.data(), lKey.length() ) != 0 )
+    {
+        return false;
+    }
+
+    lValue = std::string_view( mpStrings + lSlot.miValueOffset, lSlot.miValueLength );
+    return true;
+}
+
+bool cLookupTable::Fail( const char* lpError )
+{
+    mpError = lpError;
+    miNumEntries = 0;
+    return false;
+}
+
+// Mixed per seed in GetSlot
+uint64_t cLookupTable::HashKey( std::string_view lKey )
+{
+    return HashFnv1a( lKey.data(), lKey.size() );
+}
+
+uint32_t cLookupTable::GetSlot( uint64_t liHash, uint32_t liSeed, uint32_t liRange )
+{
+    uint64_t liMixed = liHash ^ ( liSeed * 0x9e3779b97f4a7c15ull );
+    liMixed = ( liMixed ^ ( liMixed >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+    liMixed = ( liMixed ^ ( liMixed >> 27 ) ) * 0x94d049bb133111ebull;
+    liMixed ^= liMixed >> 31;
+
+    // Scales the top 32 bits into the range, which avoids a divide
+    return (uint32_t)( ( ( liMixed >> 32 ) * liRange ) >> 32 );
+}
+
+bool cLookupTable::Compile( const char* lpData, size_t liDataSize, std::vector< char >& lOutput, int& liNumDuplicates, std::string& lError )
+{
+    if( !cDataReader::IsBinaryData( lpData, liDataSize ) )
+    {
+        lError = "Not a binary file";
+        return false;
+    }
+
+    // Gather the pairs in document order, tracking what each open array holds
+    struct sArrayState
+    {
+        int              miNumChildren;
+        int              miNumStrings;
+        std::string_view maStrings[ 2 ];
+    };
+
+    sArrayState laArrays[ cDataReader::kiMaxDepth ];
+    std::vector< sPair > laPairs;
+    std::unordered_set< std::string_view > lKeys;
+    liNumDuplicates = 0;
+
+    cDataReader lReader( lpData + 1, liDataSize - 1 );
+    for( eReadEvent leEvent = lReader.Next(); leEvent != EReadEvent_EndOfStream; leEvent = lReader.Next() )
+    {
+        int liDepth = lReader.GetDepth();
+        switch( leEvent )
+        {
+            case EReadEvent_BeginArray:
+                if( liDepth > 1 )
+                {
+                    ++laArrays[ liDepth - 2 ].miNumChildren;
+                }
+                laArrays[ liDepth - 1 ] = sArrayState();
+                break;
+
+            case EReadEvent_Value:
+            {
+                sArrayState& lArray = laArrays[ liDepth - 1 ];
+                if( IsKeyType( lReader.GetNodeType() ) && lArray.miNumChildren == lArray.miNumStrings && lArray.miNumStrings < 2 )
+                {
+                    lArray.maStrings[ lArray.miNumStrings++ ] = lReader.GetString();
+                }
+                ++lArray.miNumChildren;
+                break;
+            }
+
+            case EReadEvent_EndArray:
+            {
+                // The reader has already stepped out, so the array that ended is one deeper than the current depth
+                const sArrayState& lArray = laArrays[ liDepth ];
+                if( lArray.miNumChildren == 2 && lArray.miNumStrings == 2 )
+                {
+                    if( lKeys.insert( lArray.maStrings[ 0 ] ).second )
+                    {
+                        laPairs.push_back( { lArray.maStrings[ 0 ], lArray.maStrings[ 1 ] } );
+                    }
+                    else
+                    {
+                        ++liNumDuplicates;
+                    }
+                }
+                break;
+            }
+
+            default:
+                lError = lReader.GetError();
+                return false;
+        }
+    }
+
+    uint32_t liNumEntries = (uint32_t)laPairs.size();
+    uint32_t liNumBuckets = ( liNumEntries + kiKeysPerBucket - 1 ) / kiKeysPerBucket;
+
+    // Hash and displace: fill the biggest buckets first, finding a seed for each that puts all of its keys in free
+    // slots, so the final buckets are mostly single keys which any free slot will take
+    std::vector< uint64_t > laHashes( liNumEntries );
+    std::vector< std::vector< uint32_t > > laBuckets( liNumBuckets );
+    for( uint32_t ii = 0; ii < liNumEntries; ++ii )
+    {
+        laHashes[ ii ] = HashKey( laPairs[ ii ].mKey );
+        laBuckets[ GetSlot( laHashes[ ii ], 0, liNumBuckets ) ].push_back( ii );
+    }
+
+    std::vector< uint32_t > laBucketOrder( liNumBuckets );
+    for( uint32_t ii = 0; ii < liNumBuckets; ++ii )
+    {
+        laBucketOrder[ ii ] = ii;
+    }
+    std::stable_sort( laBucketOrder.begin(), laBucketOrder.end(), [ &laBuckets ]( uint32_t liA, uint32_t liB )
+    {
+        return laBuckets[ liA ].size() > laBuckets[ liB ].size();
+    } );
+
+    const uint32_t kiFreeSlot = ~0u;
+    std::vector< uint32_t > laSeeds( liNumBuckets, 0 );
+    std::vector< uint32_t > laSlotEntries( liNumEntries, kiFreeSlot );
+    std::vector< uint32_t > laBucketSlots;
+    for( uint32_t liBucket : laBucketOrder )
+    {
+        const std::vector< uint32_t >& laEntries = laBuckets[ liBucket ];
+        if( laEntries.empty() )
+        {
+            break;
+        }
+
+        uint32_t liSeed = 1;
+        for( ; liSeed < kiMaxSeed; ++liSeed )
+        {
+            laBucketSlots.clear();
+            bool lbPlaced = true;
+            for( uint32_t liEntry : laEntries )
+            {
+                uint32_t liSlot = GetSlot( laHashes[ liEntry ], liSeed, liNumEntries );
+                if( laSlotEntries[ liSlot ] != kiFreeSlot || std::find( laBucketSlots.begin(), laBucketSlots.end(), liSlot ) != laBucketSlots.end() )
+                {
+                    lbPlaced = false;
+                    break;
+                }
+                laBucketSlots.push_back( liSlot );
+            }
+
+            if( lbPlaced )
+            {
+                break;
+            }
+        }
+
+        if( liSeed == kiMaxSeed )
+        {
+            lError = "Couldn't find a perfect hash for the keys";
+            return false;
+        }
+
+        laSeeds[ liBucket ] = liSeed;
+        for( size_t ii = 0; ii < laEntries.size(); ++ii )
+        {
+            laSlotEntries[ laBucketSlots[ ii ] ] = laEntries[ ii ];
+        }
+    }
+
+    // Strings go in slot order, so neighbouring slots have neighbouring strings
+    uint64_t liStringsSize = 0;
+    for( const sPair& lPair : laPairs )
+    {
+        liStringsSize += lPair.mKey.length() + lPair.mValue.length();
+    }
+    if( liStringsSize > UINT32_MAX )
+    {
+        lError = "Too much string data for a lookup table";
+        return false;
+    }
+
+    lOutput.clear();
+    lOutput.reserve( kiHeaderSize + liNumBuckets * sizeof( uint32_t ) + liNumEntries * sizeof( sSlot ) + liStringsSize );
+    lOutput.insert( lOutput.end(), kaMagic, kaMagic + sizeof( kaMagic ) );
+    Append< uint32_t >( lOutput, liNumEntries );
+    Append< uint32_t >( lOutput, liNumBuckets );
+    Append< uint32_t >( lOutput, (uint32_t)liStringsSize );
+
+    for( uint32_t liSeed : laSeeds )
+    {
+        Append< uint32_t >( lOutput, liSeed );
+    }
+
+    uint32_t liStringOffset = 0;
+    for( uint32_t liEntry : laSlotEntries )
+    {
+        const sPair& lPair = laPairs[ liEntry ];
+        Append< uint32_t >( lOutput, liStringOffset );
+        Append< uint32_t >( lOutput, (uint32_t)lPair.mKey.length() );
+        Append< uint32_t >( lOutput, liStringOffset + (uint32_t)lPair.mKey.length() );
+        Append< uint32_t >( lOutput, (uint32_t)lPair.mValue.length() );
+        liStringOffset += (uint32_t)( lPair.mKey.length() + lPair.mValue.length() );
+    }
+
+    for( uint32_t liEntry : laSlotEntries )
+    {
+        const sPair& lPair = laPairs[ liEntry ];
+        lOutput.insert( lOutput.end(), lPair.mKey.begin(), lPair.mKey.end() );
+        lOutput.insert( lOutput.end(), lPair.mValue.begin(), lPair.mValue.end() );
+    }
+
+    return true;
+}
+
+bool CompileLookupTable( const std::string& lFilename, std::string& lOutputFilename, std::string& lError )
+{
+    cDtaFile lDataFile( lFilename.c_str() );
+    std::vector< char > laBinary;
+    if( !LoadAsBinary( lDataFile, laBinary, lError ) )
+    {
+        return false;
+    }
+
+    std::vector< char > laTable;
+    int liNumDuplicates = 0;
+    if( !cLookupTable::Compile( laBinary.data(), laBinary.size(), laTable, liNumDuplicates, lError ) )
+    {
+        return false;
+    }
+
+    if( liNumDuplicates )
+    {
+        std::cout << lFilename.c_str() << ": dropped " << liNumDuplicates << " duplicate keys\n";
+    }
+
+    lOutputFilename = cDtaFile::GetOutputFilename( lFilename, ".sdt" );
+
+    FILE* lpOutputFile = nullptr;
+    fopen_s( &lpOutputFile, lOutputFilename.c_str(), "wb" );
+    if( !lpOutputFile )
+    {
+        lError = "Error opening file \"" + lOutputFilename + "\" for writing";
+        return false;
+    }
+
+    fwrite( laTable.data(), laTable.size(), 1, lpOutputFile );
+    fclose( lpOutputFile );
+
+    return true;
+}
+
+bool BenchmarkLookupTable( const std::string& lFilename, std::string& lError )
+{
+    using tClock = std::chrono::steady_clock;
+
+    cDtaFile lDataFile( lFilename.c_str() );
+    std::vector< char > laBinary;
+    if( !LoadAsBinary( lDataFile, laBinary, lError ) )
+    {
+        return false;
+    }
+
+    std::vector< char > laTableData;
+    int liNumDuplicates = 0;
+    cLookupTable lTable;
+    if( !cLookupTable::Compile( laBinary.data(), laBinary.size(), laTableData, liNumDuplicates, lError ) )
+    {
+        return false;
+    }
+    if( !lTable.Attach( laTableData.data(), laTableData.size() ) )
+    {
+        lError = lTable.GetError();
+        return false;
+    }
+
+    const cDataNodeArray* lpRoot = static_cast< const cDataNodeArray* >( lDataFile.GetRootNode() );
+    std::vector< std::string_view > laKeys;
+    CollectKeys( lpRoot, laKeys );
+
+    std::vector< std::string > laTableKeys;
+    laTableKeys.reserve( laKeys.size() );
+    for( std::string_view lKey : laKeys )
+    {
+        laTableKeys.push_back( cDataNodeString::Unescape( lKey ) );
+    }
+
+    // Both lookups have to agree before their times mean anything
+    for( size_t ii = 0; ii < laKeys.size(); ++ii )
+    {
+        std::string_view lTreeValue;
+        std::string_view lTableValue;
+        if( !FindInTree( lpRoot, laKeys[ ii ], lTreeValue ) || !lTable.Find( laTableKeys[ ii ], lTableValue ) || cDataNodeString::Unescape( lTreeValue ) != lTableValue )
+        {
+            lError = "Lookup mismatch for key \"" + laTableKeys[ ii ] + "\"";
+            return false;
+        }
+    }
+
+    size_t liChecksum = 0;
+    tClock::time_point lStart = tClock::now();
+    for( int liRound = 0; liRound < kiBenchmarkRounds; ++liRound )
+    {
+        for( std::string_view lKey : laKeys )
+        {
+            std::string_view lValue;
+            liChecksum += FindInTree( lpRoot, lKey, lValue );
+        }
+    }
+    double lfTreeSeconds = std::chrono::duration< double >( tClock::now() - lStart ).count();
+
+    lStart = tClock::now();
+    for( int liRound = 0; liRound < kiBenchmarkRounds; ++liRound )
+    {
+        for( const std::string& lKey : laTableKeys )
+        {
+            std::string_view lValue;
+            liChecksum -= lTable.Find( lKey, lValue );
+        }
+    }
+    double lfTableSeconds = std::chrono::duration< double >( tClock::now() - lStart ).count();
+
+    double lfNumLookups = (double)laKeys.size() * kiBenchmarkRounds;
+    if( lfNumLookups == 0 )
+    {
+        lError = "No key/value pairs to look up";
+        return false;
+    }
+
+    std::cout << lFilename.c_str() << ": " << lTable.GetNumEntries() << " keys, " << laTableData.size() << " byte table";
+    if( liNumDuplicates )
+    {
+        std::cout << ", " << liNumDuplicates << " duplicate keys";
+    }
+    std::cout << "\n";
+    std::cout << "  tree scan    : " << lfTreeSeconds * 1e9 / lfNumLookups << " ns per lookup\n";
+    std::cout << "  lookup table : " << lfTableSeconds * 1e9 / lfNumLookups << " ns per lookup\n";
+    std::cout << "  speedup      : " << ( lfTableSeconds > 0 ? lfTreeSeconds / lfTableSeconds : 0 ) << "x\n";
+
+    // Using the results keeps the lookups from being optimised away
+    if( liChecksum != 0 )
+    {
+        lError = "Lookups found different numbers of keys";
+        return false;
+    }
+    return true;
+}
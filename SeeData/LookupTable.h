@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+
+// Read only key to string table compiled from the ( "key" "value" ) pairs of a data file, such as locale_keep. Keys
+// are placed with a minimal perfect hash built by hash and displace, so a lookup hashes the key once, reads one seed
+// and compares one key. The file is used straight from memory, with every offset relative to the start of the data.
+//
+//   "SDT1"                                     magic
+//   uint32                                     number of entries
+//   uint32                                     number of buckets
+//   uint32                                     size of the string data
+//   uint32 x buckets                           seed for each bucket
+//   { uint32 key offset, key length,
+//     value offset, value length } x entries   one slot per entry
+//   bytes                                      keys and values, packed together
+class cLookupTable
+{
+public:
+    static constexpr size_t kiHeaderSize = 16;
+
+    // Maps a compiled table file
+    bool Open( const char* lpFilename );
+
+    // Uses a compiled table that's already in memory, which must outlive this
+    bool Attach( const char* lpData, size_t liDataSize );
+
+    bool Find( std::string_view lKey, std::string_view& lValue ) const;
+
+    uint32_t GetNumEntries() const
+    {
+        return miNumEntries;
+    }
+
+    const char* GetError() const
+    {
+        return mpError;
+    }
+
+    // Builds a table from every array in the data holding exactly two strings. Strings are stored as they are in
+    // binary files, without escaping. Later duplicates of a key are dropped and counted in liNumDuplicates.
+    static bool Compile( const char* lpData, size_t liDataSize, std::vector< char >& lOutput, int& liNumDuplicates, std::string& lError );
+
+    static uint64_t HashKey( std::string_view lKey );
+    static uint32_t GetSlot( uint64_t liHash, uint32_t liSeed, uint32_t liRange );
+
+private:
+    struct sSlot
+    {
+        uint32_t miKeyOffset;
+        uint32_t miKeyLength;
+        uint32_t miValueOffset;
+        uint32_t miValueLength;
+    };
+
+    bool Fail( const char* lpError );
+
+    cMappedFile     mFile;
+    const uint32_t* mpSeeds = nullptr;
+    const sSlot*    mpSlots = nullptr;
+    const char*     mpStrings = nullptr;
+    uint32_t        miNumEntries = 0;
+    uint32_t        miNumBuckets = 0;
+    uint32_t        miStringsSize = 0;
+    const char*     mpError = nullptr;
+};
+
+// Compiles lFilename, in any format cDtaFile reads, to a table alongside it with the extension .sdt
+bool CompileLookupTable( const std::string& lFilename, std::string& lOutputFilename, std::string& lError );
+
+// Times looking up every key of lFilename in a compiled table against walking the loaded node tree for it
+bool BenchmarkLookupTable( const std::string& lFilename, std::string& lError );
@@ -0,0 +1,136 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+cMappedFile::~cMappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool cMappedFile::Open( const char* lpFilename, bool lbWritable )
+{
+    Close();
+
+    HANDLE lpFile = CreateFileA( lpFilename, lbWritable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if( lpFile == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+    mpFile = lpFile;
+
+    LARGE_INTEGER liFileSize;
+    if( !GetFileSizeEx( lpFile, &liFileSize ) )
+    {
+        Close();
+        return false;
+    }
+    miSize = (size_t)liFileSize.QuadPart;
+    mbOpen = true;
+
+    // Empty files can't be mapped, but there's nothing to map anyway
+    if( miSize == 0 )
+    {
+        return true;
+    }
+
+    mpMapping = CreateFileMappingA( lpFile, nullptr, lbWritable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr );
+    if( mpMapping )
+    {
+        mpData = (char*)MapViewOfFile( mpMapping, lbWritable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0 );
+    }
+
+    if( !mpData )
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void cMappedFile::Close()
+{
+    if( mpData )
+    {
+        UnmapViewOfFile( mpData );
+    }
+    if( mpMapping )
+    {
+        CloseHandle( mpMapping );
+    }
+    if( mpFile )
+    {
+        CloseHandle( mpFile );
+    }
+
+    mpData = nullptr;
+    mpMapping = nullptr;
+    mpFile = nullptr;
+    miSize = 0;
+    mbOpen = false;
+}
+
+#else
+
+bool cMappedFile::Open( const char* lpFilename, bool lbWritable )
+{
+    Close();
+
+    miFile = open( lpFilename, lbWritable ? O_RDWR : O_RDONLY );
+    if( miFile < 0 )
+    {
+        return false;
+    }
+
+    struct stat lFileStats;
+    if( fstat( miFile, &lFileStats ) != 0 )
+    {
+        Close();
+        return false;
+    }
+    miSize = (size_t)lFileStats.st_size;
+    mbOpen = true;
+
+    // Empty files can't be mapped, but there's nothing to map anyway
+    if( miSize == 0 )
+    {
+        return true;
+    }
+
+    void* lpData = mmap( nullptr, miSize, lbWritable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, miFile, 0 );
+    if( lpData == MAP_FAILED )
+    {
+        Close();
+        return false;
+    }
+    mpData = (char*)lpData;
+    return true;
+}
+
+void cMappedFile::Close()
+{
+    if( mpData )
+    {
+        munmap( mpData, miSize );
+    }
+    if( miFile >= 0 )
+    {
+        close( miFile );
+    }
+
+    mpData = nullptr;
+    miFile = -1;
+    miSize = 0;
+    mbOpen = false;
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+
+// A whole file mapped into memory. Writable mappings are shared, so edits to the data go straight back to the file.
+class cMappedFile
+{
+public:
+    cMappedFile() {}
+    ~cMappedFile();
+
+    cMappedFile( const cMappedFile& ) = delete;
+    cMappedFile& operator=( const cMappedFile& ) = delete;
+
+    bool Open( const char* lpFilename, bool lbWritable );
+    void Close();
+
+    bool IsOpen() const
+    {
+        return mbOpen;
+    }
+
+    char* GetData() const
+    {
+        return mpData;
+    }
+
+    size_t GetSize() const
+    {
+        return miSize;
+    }
+
+private:
+    char*  mpData = nullptr;
+    size_t miSize = 0;
+    bool   mbOpen = false;
+
+#ifdef _WIN32
+    void*  mpFile = nullptr;
+    void*  mpMapping = nullptr;
+#else
+    int    miFile = -1;
+#endif
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+// Stored as a single byte so it packs in with the node data that follows it
+enum eNodeType : unsigned char {
+    ENodeType_Integer0 = 0,
+    ENodeType_Float = 1,
+    ENodeType_Text = 2,
+    ENodeType_String = 5,
+    ENodeType_Integer6 = 6,
+    ENodeType_Integer8 = 8,
+    ENodeType_Integer9 = 9,
+    ENodeType_Tree1 = 16,
+    ENodeType_Tree2 = 17,
+    ENodeType_Id = 18,
+    ENodeType_IncludeFile = 33,
+    ENodeType_Define = 35,
+    ENodeType_Invalid
+};
+
+inline bool IsIntegerType( eNodeType leNodeType )
+{
+    return leNodeType == ENodeType_Integer0 ||
+           leNodeType == ENodeType_Integer6 ||
+           leNodeType == ENodeType_Integer8 ||
+           leNodeType == ENodeType_Integer9;
+}
+
+inline bool IsArrayType( eNodeType leNodeType )
+{
+    return leNodeType == ENodeType_Tree1 || leNodeType == ENodeType_Tree2;
+}
+
+// Every type stored as a length and characters
+inline bool IsStringType( eNodeType leNodeType )
+{
+    return leNodeType == ENodeType_Text ||
+           leNodeType == ENodeType_String ||
+           leNodeType == ENodeType_Id ||
+           leNodeType == ENodeType_IncludeFile ||
+           leNodeType == ENodeType_Define;
+}
+
+// Strings that are data rather than directives, so can name the array they start or form a key or value.
+// Include and define nodes are directives.
+inline bool IsKeyType( eNodeType leNodeType )
+{
+    return leNodeType == ENodeType_Text ||
+           leNodeType == ENodeType_String ||
+           leNodeType == ENodeType_Id;
+}
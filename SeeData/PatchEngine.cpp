@@ -0,0 +1,520 @@
+#include "PatchEngine.h"
+#include "DataFile.h"
+#include "DataReader.h"
+#include "MappedFile.h"
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    std::string Trim( const std::string& lString )
+    {
+        size_t liStart = lString.find_first_not_of( " \t\r\n" );
+        if( liStart == std::string::npos )
+        {
+            return std::string();
+        }
+        size_t liEnd = lString.find_last_not_of( " \t\r\n" );
+        return lString.substr( liStart, liEnd - liStart + 1 );
+    }
+
+    // Finds the match for every command in a single pass over the binary data, and checks each can be written over
+    // the existing value without changing its size
+    struct sInPlaceEdit
+    {
+        size_t miOffset = 0;
+        bool   mbFound = false;
+        bool   mbSameSize = false;
+    };
+
+    bool FindInPlaceEdits( const char* lpData, size_t liDataSize, const std::vector< sPatchCommand >& laCommands, std::vector< sInPlaceEdit >& laEdits, std::string& lError )
+    {
+        struct sArrayState
+        {
+            std::string_view mKey;
+            int              miIndexInParent;
+            int              miChildIndex;
+        };
+        sArrayState laStack[ cDataReader::kiMaxDepth ];
+
+        laEdits.assign( laCommands.size(), sInPlaceEdit() );
+
+        cDataReader lReader( lpData, liDataSize );
+
+        // Called for the second child of the array at liDepth, whose key path is held in the stack below it.
+        // The root array isn't part of a key path.
+        auto MatchCommands = [ & ]( int liDepth, bool lbIsValue )
+        {
+            for( size_t ii = 0; ii < laCommands.size(); ++ii )
+            {
+                const sPatchCommand& lCommand = laCommands[ ii ];
+                if( laEdits[ ii ].mbFound || (int)lCommand.maPath.size() != liDepth - 1 )
+                {
+                    continue;
+                }
+
+                bool lbMatches = true;
+                for( int liLevel = 1; liLevel < liDepth && lbMatches; ++liLevel )
+                {
+                    const sKeyPathSegment& lSegment = lCommand.maPath[ liLevel - 1 ];
+                    lbMatches = lSegment.miChildIndex >= 0
+                        ? laStack[ liLevel ].miIndexInParent == lSegment.miChildIndex
+                        : laStack[ liLevel ].mKey == lSegment.mKey;
+                }
+
+                if( lbMatches )
+                {
+                    sInPlaceEdit& lEdit = laEdits[ ii ];
+                    lEdit.mbFound = true;
+                    lEdit.miOffset = lReader.GetValueOffset();
+                    lEdit.mbSameSize = lbIsValue && lReader.GetNodeType() == lCommand.meNodeType &&
+                        ( !IsStringType( lCommand.meNodeType ) || lReader.GetValueSize() == (int)lCommand.mString.length() );
+                }
+            }
+        };
+
+        for( ;; )
+        {
+            eReadEvent leEvent = lReader.Next();
+            int liDepth = lReader.GetDepth();
+
+            switch( leEvent )
+            {
+                case EReadEvent_BeginArray:
+                {
+                    int liIndexInParent = liDepth > 1 ? laStack[ liDepth - 2 ].miChildIndex++ : 0;
+                    if( liDepth > 1 && liIndexInParent == 1 )
+                    {
+                        MatchCommands( liDepth - 1, false );
+                    }
+                    laStack[ liDepth - 1 ] = { std::string_view(), liIndexInParent, 0 };
+                    break;
+                }
+
+                case EReadEvent_EndArray:
+                    break;
+
+                case EReadEvent_Value:
+                {
+                    sArrayState& lArray = laStack[ liDepth - 1 ];
+                    int liChildIndex = lArray.miChildIndex++;
+                    if( liChildIndex == 0 && IsKeyType( lReader.GetNodeType() ) )
+                    {
+                        lArray.mKey = lReader.GetString();
+                    }
+                    else if( liChildIndex == 1 )
+                    {
+                        MatchCommands( liDepth, true );
+                    }
+                    break;
+                }
+
+                case EReadEvent_EndOfStream:
+                    return true;
+
+                default:
+                    lError = lReader.GetError();
+                    return false;
+            }
+        }
+    }
+}
+
+bool cPatchScript::Load( const char* lpFilename )
+{
+    std::ifstream lInput( lpFilename );
+    if( !lInput )
+    {
+        mLastError = "Error reading patch script \"" + std::string( lpFilename ) + "\"";
+        return false;
+    }
+
+    std::string lLine;
+    int liLineNumber = 0;
+    while( std::getline( lInput, lLine ) )
+    {
+        ++liLineNumber;
+        if( !ParseLine( lLine, liLineNumber ) )
+        {
+            mLastError = std::string( lpFilename ) + "(" + std::to_string( liLineNumber ) + "): " + mLastError;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool cPatchScript::ParseLine( const std::string& lLine, int liLineNumber )
+{
+    std::string lTrimmedLine = Trim( lLine );
+    if( lTrimmedLine.empty() || lTrimmedLine[ 0 ] == ';' || lTrimmedLine[ 0 ] == '#' )
+    {
+        return true;
+    }
+
+    std::istringstream lTokens( lTrimmedLine );
+    std::string lOperation, lPath, lTypeName;
+    lTokens >> lOperation >> lPath >> lTypeName;
+
+    std::string lValue;
+    std::getline( lTokens, lValue );
+    lValue = Trim( lValue );
+
+    sPatchCommand lCommand;
+    lCommand.miLine = liLineNumber;
+
+    if( lOperation == "set" )
+    {
+        lCommand.meOperation = EPatchOperation_Set;
+    }
+    else if( lOperation == "append" )
+    {
+        lCommand.meOperation = EPatchOperation_Append;
+    }
+    else
+    {
+        mLastError = "Unknown operation \"" + lOperation + "\", expected set or append";
+        return false;
+    }
+
+    for( size_t liStart = 0; liStart <= lPath.length(); )
+    {
+        size_t liEnd = lPath.find( '/', liStart );
+        if( liEnd == std::string::npos )
+        {
+            liEnd = lPath.length();
+        }
+        if( liEnd > liStart )
+        {
+            sKeyPathSegment lSegment;
+            lSegment.mKey = lPath.substr( liStart, liEnd - liStart );
+            if( lSegment.mKey.length() > 2 && lSegment.mKey.front() == '[' && lSegment.mKey.back() == ']' )
+            {
+                char* lpEnd = nullptr;
+                long liChildIndex = strtol( lSegment.mKey.c_str() + 1, &lpEnd, 10 );
+                if( *lpEnd != ']' || liChildIndex < 0 || liChildIndex > INT_MAX )
+                {
+                    mLastError = "Invalid child index \"" + lSegment.mKey + "\" in key path";
+                    return false;
+                }
+                lSegment.miChildIndex = (int)liChildIndex;
+            }
+            lCommand.maPath.push_back( lSegment );
+        }
+        liStart = liEnd + 1;
+    }
+
+    if( lCommand.maPath.empty() )
+    {
+        mLastError = "Missing key path";
+        return false;
+    }
+
+    lCommand.meNodeType = cDataNode::GetNodeTypeFromString( lTypeName );
+    if( IsIntegerType( lCommand.meNodeType ) )
+    {
+        char* lpEnd = nullptr;
+        lCommand.miValue = (int)strtol( lValue.c_str(), &lpEnd, 10 );
+        if( lValue.empty() || *lpEnd != 0 )
+        {
+            mLastError = "Invalid integer \"" + lValue + "\"";
+            return false;
+        }
+    }
+    else if( lCommand.meNodeType == ENodeType_Float )
+    {
+        char* lpEnd = nullptr;
+        lCommand.mfValue = strtof( lValue.c_str(), &lpEnd );
+        if( lValue.empty() || *lpEnd != 0 )
+        {
+            mLastError = "Invalid float \"" + lValue + "\"";
+            return false;
+        }
+    }
+    else if( IsStringType( lCommand.meNodeType ) )
+    {
+        // Quoted values may hold escaped quotes, which are stored without the escape
+        if( lValue.length() >= 2 && lValue.front() == '\"' && lValue.back() == '\"' )
+        {
+            lValue = lValue.substr( 1, lValue.length() - 2 );
+        }
+        for( size_t ii = 0; ii < lValue.length(); ++ii )
+        {
+            if( lValue[ ii ] != '\\' || ii + 1 == lValue.length() || lValue[ ii + 1 ] != '\"' )
+            {
+                lCommand.mString += lValue[ ii ];
+            }
+        }
+    }
+    else
+    {
+        mLastError = "Can't patch values of type \"" + lTypeName + "\"";
+        return false;
+    }
+
+    maCommands.push_back( lCommand );
+    return true;
+}
+
+int cPatchEngine::Run( const std::vector< std::string >& laFilenames )
+{
+    unsigned int liNumThreads = std::thread::hardware_concurrency();
+    if( liNumThreads == 0 )
+    {
+        liNumThreads = 4;
+    }
+    if( liNumThreads > laFilenames.size() )
+    {
+        liNumThreads = (unsigned int)laFilenames.size();
+    }
+
+    std::atomic< size_t > liNextFile( 0 );
+    std::atomic< int >    liNumFailed( 0 );
+
+    std::vector< std::thread > laThreads;
+    for( unsigned int ii = 0; ii < liNumThreads; ++ii )
+    {
+        laThreads.emplace_back( [ & ]
+        {
+            for( size_t liFile = liNextFile++; liFile < laFilenames.size(); liFile = liNextFile++ )
+            {
+                std::string lResult;
+                if( !PatchFile( laFilenames[ liFile ], lResult ) )
+                {
+                    ++liNumFailed;
+                }
+
+                std::lock_guard< std::mutex > lLock( mReportMutex );
+                std::cout << lResult.c_str() << "\n";
+            }
+        } );
+    }
+
+    for( std::thread& lThread : laThreads )
+    {
+        lThread.join();
+    }
+
+    return liNumFailed;
+}
+
+bool cPatchEngine::PatchFile( const std::string& lFilename, std::string& lResult ) const
+{
+    std::string lError;
+    bool lbPatched = false;
+    if( !PatchInPlace( lFilename, lbPatched, lError ) )
+    {
+        lResult = "Failed to patch \"" + lFilename + "\": " + lError;
+        return false;
+    }
+
+    if( lbPatched )
+    {
+        lResult = "Patched " + lFilename + " in place";
+        return true;
+    }
+
+    if( !PatchTree( lFilename, lError ) )
+    {
+        lResult = "Failed to patch \"" + lFilename + "\": " + lError;
+        return false;
+    }
+
+    lResult = "Patched " + lFilename;
+    return true;
+}
+
+bool cPatchEngine::PatchInPlace( const std::string& lFilename, bool& lbPatched, std::string& lError ) const
+{
+    lbPatched = false;
+
+    cMappedFile lFile;
+    if( !lFile.Open( lFilename.c_str(), true ) )
+    {
+        lError = "Error opening file for writing";
+        return false;
+    }
+
+    // Compressed and text files always go through the tree
+    if( !cDataReader::IsBinaryData( lFile.GetData(), lFile.GetSize() ) )
+    {
+        return true;
+    }
+
+    const std::vector< sPatchCommand >& laCommands = mScript.GetCommands();
+    for( const sPatchCommand& lCommand : laCommands )
+    {
+        if( lCommand.meOperation != EPatchOperation_Set )
+        {
+            return true;
+        }
+    }
+
+    char* lpData = lFile.GetData() + 1;
+    size_t liDataSize = lFile.GetSize() - 1;
+
+    std::vector< sInPlaceEdit > laEdits;
+    if( !FindInPlaceEdits( lpData, liDataSize, laCommands, laEdits, lError ) )
+    {
+        return false;
+    }
+
+    // Either every edit is made in place or none are
+    for( const sInPlaceEdit& lEdit : laEdits )
+    {
+        if( !lEdit.mbFound || !lEdit.mbSameSize )
+        {
+            return true;
+        }
+    }
+
+    for( size_t ii = 0; ii < laCommands.size(); ++ii )
+    {
+        const sPatchCommand& lCommand = laCommands[ ii ];
+        char* lpValue = lpData + laEdits[ ii ].miOffset;
+
+        if( IsIntegerType( lCommand.meNodeType ) )
+        {
+            memcpy( lpValue, &lCommand.miValue, sizeof( int ) );
+        }
+        else if( lCommand.meNodeType == ENodeType_Float )
+        {
+            memcpy( lpValue, &lCommand.mfValue, sizeof( float ) );
+        }
+        else
+        {
+            memcpy( lpValue, lCommand.mString.data(), lCommand.mString.length() );
+        }
+    }
+
+    lbPatched = true;
+    return true;
+}
+
+bool cPatchEngine::PatchTree( const std::string& lFilename, std::string& lError ) const
+{
+    cDtaFile lDataFile( lFilename.c_str() );
+    if( lDataFile.GetError() )
+    {
+        lError = lDataFile.GetError();
+        return false;
+    }
+
+    cDataNode* lpRootNode = lDataFile.GetRootNode();
+    if( !lpRootNode || ( !IsArrayType( lpRootNode->GetNodeType() ) ) )
+    {
+        lError = "No root array";
+        return false;
+    }
+
+    for( const sPatchCommand& lCommand : mScript.GetCommands() )
+    {
+        // Values are set on the first array along the key path that has one, as in place edits are
+        int liMinChildren = lCommand.meOperation == EPatchOperation_Set ? 2 : 0;
+        cDataNodeArray* lpArray = FindArray( static_cast< cDataNodeArray* >( lpRootNode ), lCommand.maPath, 0, liMinChildren );
+        if( !lpArray )
+        {
+            bool lbHasKeyPath = FindArray( static_cast< cDataNodeArray* >( lpRootNode ), lCommand.maPath, 0, 0 ) != nullptr;
+            lError = "Key path on line " + std::to_string( lCommand.miLine ) + ( lbHasKeyPath ? " has no value to set" : " not found" );
+            return false;
+        }
+
+        cDataNode* lpValue = nullptr;
+        if( IsIntegerType( lCommand.meNodeType ) )
+        {
+            lpValue = cDataNode::Create( lCommand.meNodeType );
+            static_cast< cDataNodeAtomic< int >* >( lpValue )->SetValue( lCommand.miValue );
+        }
+        else if( lCommand.meNodeType == ENodeType_Float )
+        {
+            lpValue = cDataNode::Create( lCommand.meNodeType );
+            static_cast< cDataNodeAtomic< float >* >( lpValue )->SetValue( lCommand.mfValue );
+        }
+        else
+        {
+            lpValue = cDataNodeString::CreateFromBinaryString( lCommand.meNodeType, lCommand.mString.data(), (int)lCommand.mString.length() );
+        }
+
+        if( lCommand.meOperation == EPatchOperation_Append )
+        {
+            lpArray->AddChild( lpValue );
+        }
+        else
+        {
+            lpArray->ReplaceChild( 1, lpValue );
+        }
+    }
+
+    bool lbSaved = lDataFile.LoadedAsBinary()
+        ? lDataFile.SaveAsBinary( lFilename.c_str(), lDataFile.LoadedCompressed() )
+        : lDataFile.SaveAsText( lFilename.c_str() );
+
+    if( !lbSaved )
+    {
+        lError = lDataFile.GetError();
+        return false;
+    }
+
+    return true;
+}
+
+// Searches in document order for the first array along the key path with at least liMinChildren children, so it
+// finds the same array as the in place path when keys are repeated
+cDataNodeArray* cPatchEngine::FindArray( cDataNodeArray* lpArray, const std::vector< sKeyPathSegment >& laPath, size_t liPathIndex, int liMinChildren )
+{
+    if( liPathIndex == laPath.size() )
+    {
+        return lpArray->GetNumChildren() >= liMinChildren ? lpArray : nullptr;
+    }
+
+    const sKeyPathSegment& lSegment = laPath[ liPathIndex ];
+    if( lSegment.miChildIndex >= 0 )
+    {
+        if( lSegment.miChildIndex >= lpArray->GetNumChildren() )
+        {
+            return nullptr;
+        }
+
+        cDataNode* lpChild = lpArray->GetChild( lSegment.miChildIndex );
+        if( !IsArrayType( lpChild->GetNodeType() ) )
+        {
+            return nullptr;
+        }
+        return FindArray( static_cast< cDataNodeArray* >( lpChild ), laPath, liPathIndex + 1, liMinChildren );
+    }
+
+    for( int ii = 0; ii < lpArray->GetNumChildren(); ++ii )
+    {
+        cDataNode* lpChild = lpArray->GetChild( ii );
+        if( !IsArrayType( lpChild->GetNodeType() ) )
+        {
+            continue;
+        }
+
+        cDataNodeArray* lpChildArray = static_cast< cDataNodeArray* >( lpChild );
+        if( lpChildArray->GetNumChildren() == 0 || !IsKeyType( lpChildArray->GetChild( 0 )->GetNodeType() ) )
+        {
+            continue;
+        }
+
+        // Script keys are unescaped, as in binary data
+        if( cDataNodeString::Unescape( static_cast< cDataNodeString* >( lpChildArray->GetChild( 0 ) )->GetString() ) != lSegment.mKey )
+        {
+            continue;
+        }
+
+        cDataNodeArray* lpFound = FindArray( lpChildArray, laPath, liPathIndex + 1, liMinChildren );
+        if( lpFound )
+        {
+            return lpFound;
+        }
+    }
+
+    return nullptr;
+}
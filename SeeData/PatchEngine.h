@@ -0,0 +1,85 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "NodeType.h"
+
+class cDataNodeArray;
+
+enum ePatchOperation {
+    EPatchOperation_Set,
+    EPatchOperation_Append,
+};
+
+// One line of a patch script:
+//
+//   set    <key path> <type> <value>     replaces the value that follows the key of the array at the path
+//   append <key path> <type> <value>     adds a value to the end of the array at the path
+//
+// A key path names nested arrays by their first string, so "system/language/default" is the array starting with
+// "default" inside the one starting with "language" inside the one starting with "system". Arrays without a name
+// are reached by their position instead: [n] is the array that is child n, counting from 0, so the unnamed list in
+// ( "supported" ( "eng" "fre" ) ) is "system/language/supported/[1]". Types are the names used in text files
+// ( "int", "float", "string", "id" etc. ) and string values may be quoted. Lines starting with ; or # are comments.
+struct sKeyPathSegment
+{
+    std::string mKey;
+    int         miChildIndex = -1;
+};
+
+struct sPatchCommand
+{
+    ePatchOperation                meOperation;
+    std::vector< sKeyPathSegment > maPath;
+    eNodeType                      meNodeType;
+    std::string                    mString;
+    int                            miValue = 0;
+    float                          mfValue = 0.0f;
+    int                            miLine = 0;
+};
+
+class cPatchScript
+{
+public:
+    bool Load( const char* lpFilename );
+
+    const std::vector< sPatchCommand >& GetCommands() const
+    {
+        return maCommands;
+    }
+
+    const std::string& GetError() const
+    {
+        return mLastError;
+    }
+
+private:
+    bool ParseLine( const std::string& lLine, int liLineNumber );
+
+    std::vector< sPatchCommand > maCommands;
+    std::string                  mLastError;
+};
+
+// Applies a patch script to many files in parallel. Binary files where every command sets a value to one with the
+// same encoded size ( ints, floats, equal length strings ) are edited in place through a memory mapping, without
+// being parsed into a tree. Everything else is loaded, edited as a tree and saved again.
+class cPatchEngine
+{
+public:
+    cPatchEngine( const cPatchScript& lScript ) : mScript( lScript ) {}
+
+    // Returns the number of files that failed to patch
+    int Run( const std::vector< std::string >& laFilenames );
+
+    bool PatchFile( const std::string& lFilename, std::string& lResult ) const;
+
+private:
+    bool PatchInPlace( const std::string& lFilename, bool& lbPatched, std::string& lError ) const;
+    bool PatchTree( const std::string& lFilename, std::string& lError ) const;
+
+    static cDataNodeArray* FindArray( cDataNodeArray* lpArray, const std::vector< sKeyPathSegment >& laPath, size_t liPathIndex, int liMinChildren );
+
+    const cPatchScript& mScript;
+    std::mutex          mReportMutex;
+};
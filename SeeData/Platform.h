@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdarg>
+#include <cstdio>
+
+#ifndef _MSC_VER
+
+// Stand-ins for the MSVC secure CRT functions, so the library also builds with GCC and Clang
+inline int fopen_s( FILE** lppFile, const char* lpFilename, const char* lpMode )
+{
+    *lppFile = fopen( lpFilename, lpMode );
+    return *lppFile ? 0 : 1;
+}
+
+template < size_t kiBufferSize >
+inline int _itoa_s( int liValue, char ( &lBuffer )[ kiBufferSize ], int liRadix )
+{
+    snprintf( lBuffer, kiBufferSize, liRadix == 16 ? "%x" : "%d", liValue );
+    return 0;
+}
+
+template < size_t kiBufferSize >
+inline int sprintf_s( char ( &lBuffer )[ kiBufferSize ], const char* lpFormat, ... )
+{
+    va_list lArguments;
+    va_start( lArguments, lpFormat );
+    vsnprintf( lBuffer, kiBufferSize, lpFormat, lArguments );
+    va_end( lArguments );
+    return 0;
+}
+
+#endif
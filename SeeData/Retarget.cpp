@@ -0,0 +1,152 @@
+#include "Retarget.h"
+#include <cstring>
+#include <vector>
+#include "Platform.h"
+
+namespace
+{
+    bool EndsWith( const std::string& lString, const char* lpSuffix )
+    {
+        size_t liSuffixLength = strlen( lpSuffix );
+        return lString.length() >= liSuffixLength &&
+               lString.compare( lString.length() - liSuffixLength, liSuffixLength, lpSuffix ) == 0;
+    }
+
+    const char* GetPlatformSuffix( ePlatform lePlatform )
+    {
+        switch( lePlatform )
+        {
+            case EPlatform_Ps3: return kpPs3Suffix;
+            case EPlatform_Ps4: return kpPs4Suffix;
+            default:            return "";
+        }
+    }
+}
+
+ePlatform GetPlatformFromString( const char* lpPlatformName )
+{
+    if( strcmp( lpPlatformName, "ps3" ) == 0 )
+    {
+        return EPlatform_Ps3;
+    }
+    if( strcmp( lpPlatformName, "ps4" ) == 0 )
+    {
+        return EPlatform_Ps4;
+    }
+    return EPlatform_Unknown;
+}
+
+ePlatform DetectPlatform( const std::string& lFilename, const char* lpData, size_t liDataSize )
+{
+    if( !cDataReader::IsBinaryData( lpData, liDataSize ) )
+    {
+        return EPlatform_Unknown;
+    }
+
+    if( EndsWith( lFilename, kpPs3Suffix ) )
+    {
+        return EPlatform_Ps3;
+    }
+    if( EndsWith( lFilename, kpPs4Suffix ) )
+    {
+        return EPlatform_Ps4;
+    }
+    return EPlatform_Unknown;
+}
+
+bool ValidateBinaryData( const char* lpData, size_t liDataSize, std::string& lError )
+{
+    if( !cDataReader::IsBinaryData( lpData, liDataSize ) )
+    {
+        lError = "Not a binary file";
+        return false;
+    }
+
+    cDataReader lReader( lpData + 1, liDataSize - 1 );
+    for( eReadEvent leEvent = lReader.Next(); leEvent != EReadEvent_EndOfStream; leEvent = lReader.Next() )
+    {
+        if( leEvent == EReadEvent_Error )
+        {
+            lError = lReader.GetError();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RetargetFile( const std::string& lFilename, ePlatform leTargetPlatform, bool lbOverwrite, std::string& lOutputFilename, std::string& lError )
+{
+    FILE* lpInputFile = nullptr;
+    fopen_s( &lpInputFile, lFilename.c_str(), "rb" );
+    if( !lpInputFile )
+    {
+        lError = "Error reading file \"" + lFilename + "\"";
+        return false;
+    }
+
+    fseek( lpInputFile, 0, SEEK_END );
+    long liDataSize = ftell( lpInputFile );
+    fseek( lpInputFile, 0, SEEK_SET );
+
+    std::vector< char > laData( liDataSize > 0 ? liDataSize : 0 );
+    bool lbRead = laData.empty() || fread( laData.data(), laData.size(), 1, lpInputFile ) == 1;
+    fclose( lpInputFile );
+
+    if( !lbRead )
+    {
+        lError = "Error reading file \"" + lFilename + "\"";
+        return false;
+    }
+
+    ePlatform leSourcePlatform = DetectPlatform( lFilename, laData.data(), laData.size() );
+    if( leSourcePlatform == EPlatform_Unknown )
+    {
+        lError = "\"" + lFilename + "\" isn't a binary file with a _ps3 or _ps4 suffix";
+        return false;
+    }
+
+    if( leSourcePlatform == leTargetPlatform )
+    {
+        lError = "\"" + lFilename + "\" is already for that platform";
+        return false;
+    }
+
+    if( !ValidateBinaryData( laData.data(), laData.size(), lError ) )
+    {
+        lError = "Failed to read \"" + lFilename + "\": " + lError;
+        return false;
+    }
+
+    lOutputFilename = lFilename.substr( 0, lFilename.length() - strlen( GetPlatformSuffix( leSourcePlatform ) ) ) + GetPlatformSuffix( leTargetPlatform );
+
+    if( !lbOverwrite )
+    {
+        FILE* lpExistingFile = nullptr;
+        fopen_s( &lpExistingFile, lOutputFilename.c_str(), "rb" );
+        if( lpExistingFile )
+        {
+            fclose( lpExistingFile );
+            lError = "\"" + lOutputFilename + "\" already exists, use --force to overwrite it";
+            return false;
+        }
+    }
+
+    FILE* lpOutputFile = nullptr;
+    fopen_s( &lpOutputFile, lOutputFilename.c_str(), "wb" );
+    if( !lpOutputFile )
+    {
+        lError = "Error opening file \"" + lOutputFilename + "\" for writing";
+        return false;
+    }
+
+    bool lbWritten = fwrite( laData.data(), laData.size(), 1, lpOutputFile ) == 1;
+    fclose( lpOutputFile );
+
+    if( !lbWritten )
+    {
+        lError = "Error writing file \"" + lOutputFilename + "\"";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include "DataReader.h"
+
+enum ePlatform {
+    EPlatform_Ps3,
+    EPlatform_Ps4,
+    EPlatform_Unknown
+};
+
+// The PS3 and PS4 builds share one binary layout: little endian, with 32 bit type tags and string lengths and 16 bit
+// child counts and ids. Their files differ in content, not encoding, so retargeting a file checks that it's well
+// formed binary data and writes it under the other platform's filename.
+constexpr const char* kpPs3Suffix = "_ps3";
+constexpr const char* kpPs4Suffix = "_ps4";
+
+ePlatform   GetPlatformFromString( const char* lpPlatformName );
+
+// Works out which platform binary data was built for, from its filename suffix since the layouts can't be told
+// apart from the data alone. Returns EPlatform_Unknown if it isn't binary data or has no platform suffix.
+ePlatform   DetectPlatform( const std::string& lFilename, const char* lpData, size_t liDataSize );
+
+// Walks every node of binary data, failing on anything the reader can't parse
+bool        ValidateBinaryData( const char* lpData, size_t liDataSize, std::string& lError );
+
+// Writes a binary file for leTargetPlatform alongside the source with the platform suffix swapped. Fails if the
+// source is already for that platform, or if the output exists and lbOverwrite isn't set. Compressed files have no
+// platform suffix, so they aren't retargeted.
+bool        RetargetFile( const std::string& lFilename, ePlatform leTargetPlatform, bool lbOverwrite, std::string& lOutputFilename, std::string& lError );
@@ -1,37 +1,298 @@
 #include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include "BatchConverter.h"
+#include "CorpusIndex.h"
 #include "DataFile.h"
+#include "LookupTable.h"
+#include "PatchEngine.h"
+#include "Retarget.h"
 
 using namespace std;
 
+static void PrintUsage()
+{
+    cout << "Usage : seedata [--json | --ndjson | --compress] <filename> \n";
+    cout << "        seedata --batch <filename> [<filename> ...] \n";
+    cout << "        seedata --retarget <ps3 | ps4> [--force] <filename> [<filename> ...] \n";
+    cout << "        seedata --patch <script> <filename> [<filename> ...] \n";
+    cout << "        seedata --mem-report <filename> [<filename> ...] \n";
+    cout << "        seedata --compile-table <filename> [<filename> ...] \n";
+    cout << "        seedata --bench-table <filename> [<filename> ...] \n";
+    cout << "        seedata --index <directory> \n";
+    cout << "        seedata --search <directory> <token>[*] \n";
+}
+
+// Loads each file and prints how much memory its nodes hold, per node type and in total
+static int PrintMemoryReport( int argc, const char* argv[] )
+{
+    sNodeMemoryReport lReport;
+    int liNumFailed = 0;
+    for( int ii = 2; ii < argc; ++ii )
+    {
+        cDtaFile lDataFile( argv[ ii ] );
+        if( lDataFile.GetError() )
+        {
+            cout << lDataFile.GetError() << "\n";
+            ++liNumFailed;
+            continue;
+        }
+        if( !lDataFile.GetRootNode() )
+        {
+            cout << "No data loaded from \"" << argv[ ii ] << "\"\n";
+            ++liNumFailed;
+            continue;
+        }
+        lDataFile.GetRootNode()->AccumulateMemory( lReport );
+    }
+
+    cout << left << setw( 14 ) << "Type" << right << setw( 12 ) << "Nodes" << setw( 14 ) << "Node bytes" << setw( 14 ) << "Heap bytes" << setw( 14 ) << "Total" << "\n";
+
+    sNodeMemoryReport::sEntry lTotal;
+    for( int ii = 0; ii < ENodeType_Invalid; ++ii )
+    {
+        const sNodeMemoryReport::sEntry& lEntry = lReport.maEntries[ ii ];
+        if( !lEntry.miNumNodes )
+        {
+            continue;
+        }
+
+        cout << left << setw( 14 ) << cDataNode::GetValueAsString( ii, true ) << right << setw( 12 ) << lEntry.miNumNodes << setw( 14 ) << lEntry.miNodeBytes
+             << setw( 14 ) << lEntry.miHeapBytes << setw( 14 ) << lEntry.miNodeBytes + lEntry.miHeapBytes << "\n";
+
+        lTotal.miNumNodes += lEntry.miNumNodes;
+        lTotal.miNodeBytes += lEntry.miNodeBytes;
+        lTotal.miHeapBytes += lEntry.miHeapBytes;
+    }
+
+    cout << left << setw( 14 ) << "Total" << right << setw( 12 ) << lTotal.miNumNodes << setw( 14 ) << lTotal.miNodeBytes
+         << setw( 14 ) << lTotal.miHeapBytes << setw( 14 ) << lTotal.miNodeBytes + lTotal.miHeapBytes << "\n";
+
+    return liNumFailed ? 3 : 0;
+}
+
 int main( int argc, const char *argv[], const char *envp[] )
 {
-    if( argc != 2 )
+    enum eOutputFormat
     {
-        cout << "Usage : seedata <filename> \n";
-        return 1;
+        EOutputFormat_Default,
+        EOutputFormat_Json,
+        EOutputFormat_NdJson,
+        EOutputFormat_Compressed,
+    };
+
+    if( argc >= 3 && strcmp( argv[ 1 ], "--batch" ) == 0 )
+    {
+        cBatchConverter lBatchConverter;
+        int liNumFailed = lBatchConverter.Run( vector< string >( argv + 2, argv + argc ) );
+        return liNumFailed ? 3 : 0;
+    }
+
+    if( argc >= 4 && strcmp( argv[ 1 ], "--patch" ) == 0 )
+    {
+        cPatchScript lScript;
+        if( !lScript.Load( argv[ 2 ] ) )
+        {
+            cout << lScript.GetError().c_str() << "\n";
+            return 2;
+        }
+
+        cPatchEngine lPatchEngine( lScript );
+        int liNumFailed = lPatchEngine.Run( vector< string >( argv + 3, argv + argc ) );
+        return liNumFailed ? 3 : 0;
+    }
+
+    if( argc >= 3 && strcmp( argv[ 1 ], "--mem-report" ) == 0 )
+    {
+        return PrintMemoryReport( argc, argv );
+    }
+
+    if( argc == 3 && strcmp( argv[ 1 ], "--index" ) == 0 )
+    {
+        chrono::steady_clock::time_point lStart = chrono::steady_clock::now();
+
+        cCorpusIndexBuilder lBuilder;
+        string lError;
+        if( !lBuilder.Update( argv[ 2 ], lError ) )
+        {
+            cout << lError.c_str() << "\n";
+            return 3;
+        }
+
+        const sIndexStats& lStats = lBuilder.GetStats();
+        cout << "Indexed " << lStats.miNumFiles << " files in " << argv[ 2 ] << " ( " << lStats.miNumParsed << " parsed, "
+             << lStats.miNumUnchanged << " unchanged, " << lStats.miNumNotData << " not data, " << lStats.miNumFailed << " failed ), "
+             << lStats.miNumTokens << " tokens, " << lStats.miNumPostings << " locations in "
+             << chrono::duration_cast< chrono::milliseconds >( chrono::steady_clock::now() - lStart ).count() << "ms\n";
+        return lStats.miNumFailed ? 3 : 0;
+    }
+
+    if( argc == 4 && strcmp( argv[ 1 ], "--search" ) == 0 )
+    {
+        chrono::steady_clock::time_point lStart = chrono::steady_clock::now();
+
+        cCorpusIndex lIndex;
+        if( !lIndex.Open( argv[ 2 ] ) )
+        {
+            cout << lIndex.GetError() << "\n";
+            return 2;
+        }
+
+        vector< cCorpusIndex::sMatch > laMatches;
+        lIndex.Search( argv[ 3 ], laMatches );
+
+        // Prefix searches can match many tokens, so say which one was found
+        bool lbShowToken = argv[ 3 ][ 0 ] && argv[ 3 ][ strlen( argv[ 3 ] ) - 1 ] == '*';
+        for( const cCorpusIndex::sMatch& lMatch : laMatches )
+        {
+            cout << lMatch.mFilename << ": " << ( lMatch.mKeyPath.empty() ? "/" : lMatch.mKeyPath );
+            if( lbShowToken )
+            {
+                cout << " \"" << lMatch.mToken << "\"";
+            }
+            cout << "\n";
+        }
+
+        cout << laMatches.size() << " matches in "
+             << chrono::duration_cast< chrono::microseconds >( chrono::steady_clock::now() - lStart ).count() / 1000.0 << "ms\n";
+        return 0;
     }
 
-    string lFilename = argv[ 1 ];
-    int liSlashIndex = lFilename.rfind( '/' );
-    int liBackslashIndex = lFilename.rfind( '\\' );
-    int liExtensionIndex = lFilename.rfind( '.' );
-    if( liExtensionIndex < liSlashIndex ||
-        liExtensionIndex < liBackslashIndex ||
-        liExtensionIndex < 0 )
+    if( argc >= 3 && strcmp( argv[ 1 ], "--compile-table" ) == 0 )
     {
-        liExtensionIndex = lFilename.length();
+        int liNumFailed = 0;
+        for( int ii = 2; ii < argc; ++ii )
+        {
+            string lOutputFilename;
+            string lError;
+            if( CompileLookupTable( argv[ ii ], lOutputFilename, lError ) )
+            {
+                cout << "Compiled " << argv[ ii ] << " to " << lOutputFilename.c_str() << "\n";
+            }
+            else
+            {
+                cout << lError.c_str() << "\n";
+                ++liNumFailed;
+            }
+        }
+        return liNumFailed ? 3 : 0;
     }
 
-    string lBinaryOutputFilename = lFilename.substr( 0, liExtensionIndex ) + ".bin";
-    string lTextOutputFilename = lFilename.substr( 0, liExtensionIndex ) + ".txt";
+    if( argc >= 3 && strcmp( argv[ 1 ], "--bench-table" ) == 0 )
+    {
+        int liNumFailed = 0;
+        for( int ii = 2; ii < argc; ++ii )
+        {
+            string lError;
+            if( !BenchmarkLookupTable( argv[ ii ], lError ) )
+            {
+                cout << lError.c_str() << "\n";
+                ++liNumFailed;
+            }
+        }
+        return liNumFailed ? 3 : 0;
+    }
+
+    if( argc >= 4 && strcmp( argv[ 1 ], "--retarget" ) == 0 )
+    {
+        ePlatform leTargetPlatform = GetPlatformFromString( argv[ 2 ] );
+        if( leTargetPlatform == EPlatform_Unknown )
+        {
+            cout << "Unknown platform \"" << argv[ 2 ] << "\", expected ps3 or ps4\n";
+            return 1;
+        }
 
-    cDtaFile lDataFile( argv[ 1 ] );
+        int liFirstFile = 3;
+        bool lbOverwrite = strcmp( argv[ liFirstFile ], "--force" ) == 0;
+        if( lbOverwrite )
+        {
+            ++liFirstFile;
+        }
+
+        if( liFirstFile == argc )
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        int liNumFailed = 0;
+        for( int ii = liFirstFile; ii < argc; ++ii )
+        {
+            string lOutputFilename;
+            string lError;
+            if( RetargetFile( argv[ ii ], leTargetPlatform, lbOverwrite, lOutputFilename, lError ) )
+            {
+                cout << "Converted " << argv[ ii ] << " to " << lOutputFilename.c_str() << "\n";
+            }
+            else
+            {
+                cout << lError.c_str() << "\n";
+                ++liNumFailed;
+            }
+        }
+        return liNumFailed ? 3 : 0;
+    }
+
+    eOutputFormat leOutputFormat = EOutputFormat_Default;
+    if( argc == 3 && strcmp( argv[ 1 ], "--json" ) == 0 )
+    {
+        leOutputFormat = EOutputFormat_Json;
+    }
+    else if( argc == 3 && strcmp( argv[ 1 ], "--ndjson" ) == 0 )
+    {
+        leOutputFormat = EOutputFormat_NdJson;
+    }
+    else if( argc == 3 && strcmp( argv[ 1 ], "--compress" ) == 0 )
+    {
+        leOutputFormat = EOutputFormat_Compressed;
+    }
+    else if( argc != 2 )
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    const char* lpInputFilename = argv[ argc - 1 ];
+
+    string lFilename = lpInputFilename;
+    string lBinaryOutputFilename = cDtaFile::GetOutputFilename( lFilename, ".bin" );
+    string lTextOutputFilename = cDtaFile::GetOutputFilename( lFilename, ".txt" );
+
+    cDtaFile lDataFile( lpInputFilename );
     if( lDataFile.GetError() )
     {
         cout << lDataFile.GetError() << "\n";
         return 2;
     }
 
+    if( leOutputFormat == EOutputFormat_Compressed )
+    {
+        string lCompressedOutputFilename = cDtaFile::GetOutputFilename( lFilename, ".sdz" );
+        if( !lDataFile.SaveAsBinary( lCompressedOutputFilename.c_str(), true ) )
+        {
+            cout << lDataFile.GetError() << "\n";
+            return 3;
+        }
+
+        std::cout << "Converted " << lpInputFilename << " to " << lCompressedOutputFilename.c_str() << "\n";
+        return 0;
+    }
+
+    if( leOutputFormat != EOutputFormat_Default )
+    {
+        bool lbNewlineDelimited = ( leOutputFormat == EOutputFormat_NdJson );
+        string lJsonOutputFilename = cDtaFile::GetOutputFilename( lFilename, lbNewlineDelimited ? ".ndjson" : ".json" );
+        if( !lDataFile.SaveAsJson( lJsonOutputFilename.c_str(), lbNewlineDelimited ) )
+        {
+            cout << lDataFile.GetError() << "\n";
+            return 3;
+        }
+
+        std::cout << "Converted " << lpInputFilename << " to " << lJsonOutputFilename.c_str() << "\n";
+        return 0;
+    }
+
     if( ( lDataFile.LoadedAsBinary() && !lDataFile.SaveAsText( lTextOutputFilename.c_str() ) ) ||
         ( lDataFile.LoadedAsText() && !lDataFile.SaveAsBinary( lBinaryOutputFilename.c_str() ) ) )
     {
@@ -39,7 +300,7 @@ int main( int argc, const char *argv[], const char *envp[] )
         return 3;
     }
 
-    std::cout << "Converted " << argv[ 1 ] << " to " << ( lDataFile.LoadedAsBinary() ? lTextOutputFilename.c_str() : lBinaryOutputFilename.c_str() ) << "\n";
+    std::cout << "Converted " << lpInputFilename << " to " << ( lDataFile.LoadedAsBinary() ? lTextOutputFilename.c_str() : lBinaryOutputFilename.c_str() ) << "\n";
 
     return 0;
 }
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "BlockCompression.h"
+
+namespace
+{
+    int giNumFailed = 0;
+
+    void Check( bool lbPassed, const std::string& lDescription )
+    {
+        if( !lbPassed )
+        {
+            std::cout << "FAILED: " << lDescription << "\n";
+            ++giNumFailed;
+        }
+    }
+
+    // Incompressible bytes, long runs, and text with repeated words, so both stored and compressed blocks and
+    // matches of every length get exercised
+    std::vector< char > MakeData( std::mt19937& lRandom, int liKind, size_t liSize )
+    {
+        static const char* kaWords[] = { "array", "string", "symbol", "eng", "\"locale_keep\"", " ", "\n", "(", ")" };
+
+        std::vector< char > laData;
+        laData.reserve( liSize );
+        while( laData.size() < liSize )
+        {
+            if( liKind == 0 )
+            {
+                laData.push_back( (char)( lRandom() & 0xFF ) );
+            }
+            else if( liKind == 1 )
+            {
+                size_t liRun = 1 + lRandom() % 300;
+                char lcValue = (char)( lRandom() & 0x3 );
+                laData.insert( laData.end(), std::min( liRun, liSize - laData.size() ), lcValue );
+            }
+            else
+            {
+                const char* lpWord = kaWords[ lRandom() % ( sizeof( kaWords ) / sizeof( kaWords[ 0 ] ) ) ];
+                for( ; *lpWord && laData.size() < liSize; ++lpWord )
+                {
+                    laData.push_back( *lpWord );
+                }
+            }
+        }
+        return laData;
+    }
+
+    void CheckRoundTrip( const std::vector< char >& laData, const std::string& lDescription )
+    {
+        std::vector< char > laCompressed;
+        cBlockCompressor::Compress( laData.data(), laData.size(), laCompressed );
+        Check( cBlockCompressor::IsCompressed( laCompressed.data(), laCompressed.size() ), lDescription + ": has a header" );
+        Check( cBlockCompressor::GetDecompressedSize( laCompressed.data(), laCompressed.size() ) == laData.size(), lDescription + ": size" );
+
+        std::vector< char > laOutput( laData.size() + 1 );
+        Check( cBlockCompressor::Decompress( laCompressed.data(), laCompressed.size(), laOutput.data(), laData.size() ), lDescription + ": decompresses" );
+        Check( std::equal( laData.begin(), laData.end(), laOutput.begin() ), lDescription + ": decompresses exactly" );
+
+        std::vector< char > laStreamed;
+        std::vector< char > laBlock( cBlockCompressor::kiBlockSize );
+        cBlockDecoder lDecoder( laCompressed.data(), laCompressed.size() );
+        Check( lDecoder.IsValid(), lDescription + ": decoder is valid" );
+        while( lDecoder.IsValid() && !lDecoder.IsFinished() )
+        {
+            size_t liBlockSize = 0;
+            if( !lDecoder.NextBlock( laBlock.data(), liBlockSize ) )
+            {
+                break;
+            }
+            laStreamed.insert( laStreamed.end(), laBlock.begin(), laBlock.begin() + liBlockSize );
+        }
+        Check( laStreamed == laData, lDescription + ": streams exactly" );
+    }
+
+    // Must fail cleanly, whatever the damage
+    void CheckRejected( const std::vector< char >& laCompressed, size_t liClaimedSize, const std::string& lDescription )
+    {
+        std::vector< char > laOutput( liClaimedSize + 1 );
+        Check( !cBlockCompressor::Decompress( laCompressed.data(), laCompressed.size(), laOutput.data(), liClaimedSize ), lDescription );
+
+        cBlockDecoder lDecoder( laCompressed.data(), laCompressed.size() );
+        std::vector< char > laBlock( cBlockCompressor::kiBlockSize );
+        size_t liDecoded = 0;
+        size_t liBlockSize = 0;
+        while( lDecoder.IsValid() && !lDecoder.IsFinished() && lDecoder.NextBlock( laBlock.data(), liBlockSize ) )
+        {
+            liDecoded += liBlockSize;
+        }
+        Check( !lDecoder.IsValid() || !lDecoder.IsFinished() || liDecoded != liClaimedSize || liClaimedSize == 0, lDescription + " when streamed" );
+    }
+}
+
+// Round trips random data through the container, and feeds it damaged containers
+int main()
+{
+    std::mt19937 lRandom( 12345 );
+    const size_t kaSizes[] = { 0, 1, 2, 100, cBlockCompressor::kiBlockSize - 1, cBlockCompressor::kiBlockSize,
+                               cBlockCompressor::kiBlockSize + 1, 3 * cBlockCompressor::kiBlockSize + 777 };
+    for( int liKind = 0; liKind < 3; ++liKind )
+    {
+        for( size_t liSize : kaSizes )
+        {
+            CheckRoundTrip( MakeData( lRandom, liKind, liSize ), "kind " + std::to_string( liKind ) + " size " + std::to_string( liSize ) );
+        }
+        for( int liTrial = 0; liTrial < 20; ++liTrial )
+        {
+            CheckRoundTrip( MakeData( lRandom, liKind, lRandom() % ( 200 * 1024 ) ), "random kind " + std::to_string( liKind ) );
+        }
+    }
+
+    // A header claiming 4GB with no blocks behind it
+    const char kaHuge[] = "SDZ1\xff\xff\xff\xff\x00\x00\x01\x00";
+    std::vector< char > laHuge( kaHuge, kaHuge + cBlockCompressor::kiHeaderSize );
+    Check( cBlockCompressor::GetDecompressedSize( laHuge.data(), laHuge.size() ) == 0, "oversized header reports no size" );
+    Check( !cBlockDecoder( laHuge.data(), laHuge.size() ).IsValid(), "oversized header is not a valid stream" );
+    CheckRejected( laHuge, 16, "oversized header is rejected" );
+
+    // More than the blocks present could hold
+    std::vector< char > laData = MakeData( lRandom, 2, 1000 );
+    std::vector< char > laCompressed;
+    cBlockCompressor::Compress( laData.data(), laData.size(), laCompressed );
+    std::vector< char > laOverclaimed = laCompressed;
+    laOverclaimed[ 7 ] = (char)0x40;
+    Check( cBlockCompressor::GetDecompressedSize( laOverclaimed.data(), laOverclaimed.size() ) == 0, "overclaimed size reports no size" );
+
+    // Within that bound but still more than is there, which only decoding finds
+    laOverclaimed = laCompressed;
+    laOverclaimed[ 5 ] = (char)( laOverclaimed[ 5 ] + 1 );
+    CheckRejected( laOverclaimed, cBlockCompressor::GetDecompressedSize( laOverclaimed.data(), laOverclaimed.size() ), "underfilled size is rejected" );
+
+    // A large file claiming 2GB, which would be allocated once per indexer thread
+    std::vector< char > laLarge = MakeData( lRandom, 0, 2 * cBlockCompressor::kiBlockSize );
+    std::vector< char > laLargeCompressed;
+    cBlockCompressor::Compress( laLarge.data(), laLarge.size(), laLargeCompressed );
+    std::vector< char > laLargeOverclaimed = laLargeCompressed;
+    laLargeOverclaimed[ 7 ] = (char)0x7F;
+    Check( cBlockCompressor::GetDecompressedSize( laLargeOverclaimed.data(), laLargeOverclaimed.size() ) == 0, "large overclaimed size reports no size" );
+    Check( !cBlockDecoder( laLargeOverclaimed.data(), laLargeOverclaimed.size() ).IsValid(), "large overclaimed size is not a valid stream" );
+
+    // One block more than the table holds, a stored block shorter than the size claims, and bytes past the table
+    laLargeOverclaimed = laLargeCompressed;
+    uint32_t liClaimedSize = (uint32_t)laLarge.size() + 1;
+    memcpy( laLargeOverclaimed.data() + 4, &liClaimedSize, sizeof( liClaimedSize ) );
+    Check( cBlockCompressor::GetDecompressedSize( laLargeOverclaimed.data(), laLargeOverclaimed.size() ) == 0, "missing block reports no size" );
+    liClaimedSize = (uint32_t)laLarge.size() - 1;
+    memcpy( laLargeOverclaimed.data() + 4, &liClaimedSize, sizeof( liClaimedSize ) );
+    Check( cBlockCompressor::GetDecompressedSize( laLargeOverclaimed.data(), laLargeOverclaimed.size() ) == 0, "short stored block reports no size" );
+    laLargeOverclaimed = laLargeCompressed;
+    laLargeOverclaimed.push_back( 0 );
+    Check( cBlockCompressor::GetDecompressedSize( laLargeOverclaimed.data(), laLargeOverclaimed.size() ) == 0, "trailing bytes report no size" );
+
+    // Bad block sizes
+    std::vector< char > laBadBlockSize = laCompressed;
+    memset( laBadBlockSize.data() + 8, 0, 4 );
+    Check( cBlockCompressor::GetDecompressedSize( laBadBlockSize.data(), laBadBlockSize.size() ) == 0, "zero block size reports no size" );
+    laBadBlockSize[ 10 ] = 0x02;
+    Check( cBlockCompressor::GetDecompressedSize( laBadBlockSize.data(), laBadBlockSize.size() ) == 0, "block size over the limit reports no size" );
+
+    // Every truncation, and random corruption, of a multi-block container
+    laData = MakeData( lRandom, 2, 2 * cBlockCompressor::kiBlockSize + 500 );
+    cBlockCompressor::Compress( laData.data(), laData.size(), laCompressed );
+    for( size_t liSize = 0; liSize < laCompressed.size(); liSize += 1 + liSize / 16 )
+    {
+        std::vector< char > laTruncated( laCompressed.begin(), laCompressed.begin() + liSize );
+        CheckRejected( laTruncated, laData.size(), "truncated to " + std::to_string( liSize ) + " bytes is rejected" );
+    }
+    for( int liTrial = 0; liTrial < 200; ++liTrial )
+    {
+        std::vector< char > laCorrupted = laCompressed;
+        size_t liPosition = cBlockCompressor::kiHeaderSize + lRandom() % ( laCorrupted.size() - cBlockCompressor::kiHeaderSize );
+        laCorrupted[ liPosition ] ^= (char)( 1 + lRandom() % 255 );
+
+        // Corrupting literals can't be detected, only that decoding stays in bounds
+        std::vector< char > laOutput( laData.size() );
+        cBlockCompressor::Decompress( laCorrupted.data(), laCorrupted.size(), laOutput.data(), laOutput.size() );
+    }
+
+    return giNumFailed ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "DataFile.h"
+
+namespace
+{
+    int giNumFailed = 0;
+
+    void Check( bool lbPassed, const std::string& lDescription )
+    {
+        if( !lbPassed )
+        {
+            std::cout << "FAILED: " << lDescription << "\n";
+            ++giNumFailed;
+        }
+    }
+
+    // One array of short strings, then a long one, then a few short ones again
+    std::string MakeText( int liNumBefore, int liLongLength, int liNumAfter )
+    {
+        std::string lShort( 100, 's' );
+        std::string lText = "{\n  \"array\" : [\n";
+        for( int ii = 0; ii < liNumBefore; ++ii )
+        {
+            lText += "    \"string\" : \"" + lShort + "\",\n";
+        }
+        lText += "    \"string\" : \"" + std::string( liLongLength, 'L' ) + "\",\n";
+        for( int ii = 0; ii < liNumAfter; ++ii )
+        {
+            lText += "    \"string\" : \"" + lShort + "\",\n";
+        }
+        lText += "  ],\n},\n";
+        return lText;
+    }
+
+    const cDataNodeArray* GetArray( const cDtaFile& lFile )
+    {
+        const cDataNode* lpRoot = lFile.GetRootNode();
+        if( !lpRoot || !IsArrayType( lpRoot->GetNodeType() ) )
+        {
+            return nullptr;
+        }
+
+        // Text files name their outer array, binary files start inside it
+        const cDataNodeArray* lpArray = static_cast< const cDataNodeArray* >( lpRoot );
+        if( lpArray->GetNumChildren() == 1 && IsArrayType( lpArray->GetChild( 0 )->GetNodeType() ) )
+        {
+            lpArray = static_cast< const cDataNodeArray* >( lpArray->GetChild( 0 ) );
+        }
+        return lpArray;
+    }
+
+    // The output has to hold every node, or the conversion has to fail
+    void CheckConverted( const std::vector< char >& laOutput, int liNumChildren, int liLongLength, const std::string& lDescription )
+    {
+        cDtaFile lReloaded( laOutput.data(), (int)laOutput.size() );
+        const cDataNodeArray* lpArray = GetArray( lReloaded );
+        Check( !lReloaded.GetError() && lpArray, lDescription + ": output loads" );
+        if( !lpArray )
+        {
+            return;
+        }
+
+        Check( lpArray->GetNumChildren() == liNumChildren, lDescription + ": output holds every node" );
+        bool lbHasLong = false;
+        for( int ii = 0; ii < lpArray->GetNumChildren(); ++ii )
+        {
+            const cDataNode* lpChild = lpArray->GetChild( ii );
+            lbHasLong |= IsStringType( lpChild->GetNodeType() ) &&
+                         static_cast< const cDataNodeString* >( lpChild )->GetString().length() == (size_t)liLongLength;
+        }
+        Check( lbHasLong, lDescription + ": output holds the long string" );
+    }
+}
+
+// Converts files whose output runs past the first output buffer, with the overflow landing in a long string near
+// the end that has shorter ones after it
+int main()
+{
+    const int kiLongLength = 60000;
+    const int kiNumAfter = 5;
+    for( int liNumBefore = 8000; liNumBefore <= 10400; liNumBefore += 200 )
+    {
+        std::string lText = MakeText( liNumBefore, kiLongLength, kiNumAfter );
+        cDtaFile lFile( lText.data(), (int)lText.size() );
+        Check( !lFile.GetError(), "source loads" );
+
+        std::string lDescription = std::to_string( liNumBefore ) + " strings before";
+        int liNumChildren = liNumBefore + 1 + kiNumAfter;
+
+        std::vector< char > laBinary;
+        Check( lFile.ConvertToBinary( laBinary ), lDescription + ": converts to binary" );
+        CheckConverted( laBinary, liNumChildren, kiLongLength, lDescription + " as binary" );
+
+        std::vector< char > laText;
+        Check( lFile.ConvertToText( laText ), lDescription + ": converts to text" );
+        CheckConverted( laText, liNumChildren, kiLongLength, lDescription + " as text" );
+    }
+
+    return giNumFailed ? 1 : 0;
+}
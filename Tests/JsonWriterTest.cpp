@@ -0,0 +1,77 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <string>
+#include "DataNode.h"
+
+namespace
+{
+    int giNumFailed = 0;
+
+    void Check( bool lbPassed, const char* lpDescription )
+    {
+        if( !lbPassed )
+        {
+            std::cout << "FAILED: " << lpDescription << "\n";
+            ++giNumFailed;
+        }
+    }
+
+    void AddFloat( cDataNodeArray& lArray, float lfValue )
+    {
+        cDataNodeAtomic< float >* lpNode = static_cast< cDataNodeAtomic< float >* >( cDataNode::Create( ENodeType_Float ) );
+        lpNode->SetValue( lfValue );
+        lArray.AddChild( lpNode );
+    }
+
+    std::string WriteJson( const cDataNode& lRoot, bool lbNewlineDelimited )
+    {
+        FILE* lpFile = tmpfile();
+        {
+            cJsonWriter lWriter( lpFile, lbNewlineDelimited );
+            lRoot.WriteToJsonStream( lWriter );
+            lWriter.Flush();
+        }
+
+        std::string lOutput;
+        rewind( lpFile );
+        for( int liCharacter = fgetc( lpFile ); liCharacter != EOF; liCharacter = fgetc( lpFile ) )
+        {
+            lOutput += (char)liCharacter;
+        }
+        fclose( lpFile );
+        return lOutput;
+    }
+}
+
+// Checks the JSON export stays strict for values JSON can't represent directly
+int main()
+{
+    cDataNodeArray lRoot( ENodeType_Tree1 );
+    AddFloat( lRoot, 1.5f );
+    AddFloat( lRoot, std::numeric_limits< float >::quiet_NaN() );
+    AddFloat( lRoot, std::numeric_limits< float >::infinity() );
+    AddFloat( lRoot, -std::numeric_limits< float >::infinity() );
+
+    cDataNodeString* lpString = static_cast< cDataNodeString* >( cDataNode::Create( ENodeType_String ) );
+    const char kaRaw[] = "say \"hi\"\\\t\x01";
+    lpString->SetFromBinaryString( kaRaw, sizeof( kaRaw ) - 1 );
+    lRoot.AddChild( lpString );
+
+    std::string lJson = WriteJson( lRoot, false );
+    Check( lJson == "{\"array\":[{\"float\":1.500000},{\"float\":null},{\"float\":null},{\"float\":null},"
+                    "{\"string\":\"say \\\"hi\\\"\\\\\\t\\u0001\"}]}\n",
+           "non-finite floats are written as null and strings are escaped" );
+    Check( lJson.find( "nan" ) == std::string::npos && lJson.find( "inf" ) == std::string::npos, "no bare nan or inf" );
+
+    std::string lRecords = WriteJson( lRoot, true );
+    Check( lRecords.find( "{\"float\":null}\n" ) != std::string::npos, "NDJSON records use null too" );
+
+    if( giNumFailed )
+    {
+        std::cout << lJson << "\n";
+        return 1;
+    }
+    return 0;
+}